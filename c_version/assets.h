@@ -0,0 +1,18 @@
+#ifndef __assets_h__
+#define __assets_h__
+
+#include <stddef.h>
+
+
+/* a file built into the program, see the assets.c rule of the Makefile */
+typedef struct asset {
+    const char *path;  /* as the game would open it */
+    const unsigned char *data;
+    size_t size;
+} Asset;
+
+
+extern const Asset ASSETS[];
+extern const int NASSETS;
+
+#endif
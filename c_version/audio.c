@@ -0,0 +1,223 @@
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio.h"
+#include "debug.h"
+#include "queue.h"
+
+
+typedef struct trigger {
+    const Sound *sound;
+    uint64_t time;  /* when the game asked for it, in nanoseconds */
+} Trigger;
+
+typedef struct voice {
+    const Sound *sound;  /* NULL if the voice is free */
+    uint32_t position;  /* next sample to play */
+} Voice;
+
+struct audio {
+    SDL_AudioDeviceID device;
+    SDL_AudioSpec spec;  /* what the device actually uses */
+    uint64_t buffer_time;  /* nanoseconds of sound in one buffer */
+    Queue *triggers;  /* from the game thread to the audio thread */
+    Queue *latencies;  /* back from the audio thread, in microseconds */
+    Voice voices[AUDIO_VOICES];  /* only touched by the audio thread */
+};
+
+
+static void audio_callback(void *, Uint8 *, int);
+static uint64_t now_ns();
+static void voice_mix(Voice *, int16_t *, int);
+static Voice *voice_take(Audio *);
+
+
+/* the device is closed first so that the callback is not running anymore */
+void audio_close(Audio *a) {
+    if (a == NULL) {
+        return;
+    }
+    if (a->device != 0) {
+        SDL_CloseAudioDevice(a->device);
+    }
+    queue_free(a->triggers);
+    queue_free(a->latencies);
+    free(a);
+}
+
+
+/* take the oldest trigger to output latency not collected yet */
+bool audio_latency(Audio *a, uint32_t *latency) {
+    return queue_pop(a->latencies, latency);
+}
+
+
+/* decode a WAV file and convert it to the format of the device once and for
+ * all, this can run on any thread */
+Sound *audio_load(const Audio *a, SDL_RWops *rw) {
+    SDL_AudioSpec wav;
+    SDL_AudioCVT cvt = {0};
+    Uint8 *buffer = NULL;
+    Uint32 length;
+    Sound *s = NULL;
+
+    check(
+        SDL_LoadWAV_RW(rw, 1, &wav, &buffer, &length) != NULL,
+        "Failed to decode sound: %s",
+        SDL_GetError()
+    );
+    check(
+        SDL_BuildAudioCVT(
+            &cvt,
+            wav.format,
+            wav.channels,
+            wav.freq,
+            a->spec.format,
+            a->spec.channels,
+            a->spec.freq
+        ) >= 0,
+        "Failed to convert sound: %s",
+        SDL_GetError()
+    );
+    cvt.len = length;
+    cvt.buf = malloc((size_t) length * cvt.len_mult);
+    check_mem(cvt.buf);
+    memcpy(cvt.buf, buffer, length);
+    SDL_FreeWAV(buffer);
+    buffer = NULL;
+    check(SDL_ConvertAudio(&cvt) == 0, "Failed to convert sound: %s", SDL_GetError());
+    s = malloc(sizeof(Sound));
+    check_mem(s);
+    s->samples = (int16_t *) cvt.buf;
+    s->length = cvt.len_cvt / sizeof(int16_t);
+    return s;
+
+    error:
+        SDL_FreeWAV(buffer);
+        free(cvt.buf);
+        return NULL;
+}
+
+
+/* samples is the size of the device buffer in frames, smaller buffers mean
+ * less latency but more chances of running dry, the device plays signed 16
+ * bit samples but it may pick its own rate and number of channels */
+Audio *audio_open(int samples) {
+    SDL_AudioSpec want;
+    Audio *a = calloc(1, sizeof(Audio));
+
+    check_mem(a);
+    a->triggers = queue_new(AUDIO_QUEUE, sizeof(Trigger));
+    check_mem(a->triggers);
+    a->latencies = queue_new(AUDIO_QUEUE, sizeof(uint32_t));
+    check_mem(a->latencies);
+    memset(&want, 0, sizeof(want));
+    want.freq = AUDIO_FREQUENCY;
+    want.format = AUDIO_S16SYS;
+    want.channels = 2;
+    want.samples = samples;
+    want.callback = audio_callback;
+    want.userdata = a;
+    a->device = SDL_OpenAudioDevice(
+        NULL,
+        0,
+        &want,
+        &a->spec,
+        SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_CHANNELS_CHANGE
+    );
+    check(a->device != 0, "Failed to open audio device: %s", SDL_GetError());
+    a->buffer_time = (uint64_t) a->spec.samples * 1000000000 / a->spec.freq;
+    SDL_PauseAudioDevice(a->device, 0);
+    return a;
+
+    error:
+        audio_close(a);
+        return NULL;
+}
+
+
+/* start a sound from the game thread without waiting on the audio thread,
+ * false if too many triggers are already waiting */
+bool audio_play(Audio *a, const Sound *s) {
+    Trigger t = {s, now_ns()};
+    return s != NULL && queue_push(a->triggers, &t);
+}
+
+
+void audio_sound_free(Sound *s) {
+    if (s == NULL) {
+        return;
+    }
+    free(s->samples);
+    free(s);
+}
+
+
+/* runs on the audio thread whenever the device needs a buffer: start the
+ * sounds triggered since last time then add up every voice. What is written
+ * now is heard about one buffer later, which is counted in the latency */
+static void audio_callback(void *userdata, Uint8 *stream, int len) {
+    Audio *a = userdata;
+    uint64_t now = now_ns();
+    Trigger t;
+
+    while (queue_pop(a->triggers, &t)) {
+        Voice *v = voice_take(a);
+        uint32_t latency = (now - t.time + a->buffer_time) / 1000;
+        v->sound = t.sound;
+        v->position = 0;
+        queue_push(a->latencies, &latency);  /* dropped if nobody collects them */
+    }
+    memset(stream, a->spec.silence, len);
+    for (int i = 0; i < AUDIO_VOICES; i++) {
+        if (a->voices[i].sound != NULL) {
+            voice_mix(&a->voices[i], (int16_t *) stream, len / sizeof(int16_t));
+        }
+    }
+}
+
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/* add the next n samples of a voice to out with saturation, the voice is
+ * freed when its sound is over */
+static void voice_mix(Voice *v, int16_t *out, int n) {
+    const int16_t *in = v->sound->samples + v->position;
+    int left = v->sound->length - v->position;
+
+    if (n > left) {
+        n = left;
+    }
+    for (int i = 0; i < n; i++) {
+        int32_t x = out[i] + in[i];
+        out[i] = x > INT16_MAX ? INT16_MAX : x < INT16_MIN ? INT16_MIN : x;
+    }
+    v->position += n;
+    if (v->position >= v->sound->length) {
+        v->sound = NULL;
+    }
+}
+
+
+/* a free voice, or else the one that has played the longest */
+static Voice *voice_take(Audio *a) {
+    Voice *oldest = &a->voices[0];
+    for (int i = 0; i < AUDIO_VOICES; i++) {
+        if (a->voices[i].sound == NULL) {
+            return &a->voices[i];
+        }
+        if (a->voices[i].position > oldest->position) {
+            oldest = &a->voices[i];
+        }
+    }
+    return oldest;
+}
@@ -0,0 +1,34 @@
+#ifndef __audio_h__
+#define __audio_h__
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define AUDIO_FREQUENCY 44100
+#define AUDIO_DEFAULT_SAMPLES 256  /* frames per device buffer, 5.8 ms at 44.1 kHz */
+#define AUDIO_VOICES 8  /* sounds that can play at the same time */
+#define AUDIO_QUEUE 64  /* triggers and latencies waiting on each side */
+
+
+/* samples already in the format of the device so that the audio thread
+ * only has to add them up */
+typedef struct sound {
+    int16_t *samples;  /* interleaved channels */
+    uint32_t length;  /* number of int16_t */
+} Sound;
+
+/* an audio device fed by its own mixer, the game thread only pushes
+ * triggers to a lock-free queue which the callback of the device drains */
+typedef struct audio Audio;
+
+
+void audio_close(Audio *);
+bool audio_latency(Audio *, uint32_t *);
+Sound *audio_load(const Audio *, SDL_RWops *);
+Audio *audio_open(int);
+bool audio_play(Audio *, const Sound *);
+void audio_sound_free(Sound *);
+
+#endif
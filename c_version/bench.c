@@ -0,0 +1,337 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "board.h"
+#include "boards.h"
+#include "engine.h"
+#include "placement.h"
+#include "reach.h"
+#include "rng.h"
+
+
+#define BENCH_SEED 20240601
+#define BENCH_MIN_SECONDS 0.25
+#define BENCH_GAMES 200
+#define NFIXTURES 3
+
+
+/* a benchmark runs its operation n times and returns something depending on
+ * the results so that the compiler cannot drop the work */
+typedef long (*BenchFunction)(Game *, long);
+
+typedef struct fixture {
+    const char *name;
+    Board board;
+} Fixture;
+
+
+/* for bench_board_drop, the board size to run */
+const BoardOps *gBenchOps;
+
+
+long bench_board_copy(Game *, long);
+long bench_board_drop(Game *, long);
+long bench_board_drop_direct(Game *, long);
+long bench_cells(Game *, long);
+long bench_collided(Game *, long);
+long bench_drop_full_rows(Game *, long);
+long bench_games(Game *, long);
+long bench_placement_scan(Game *, long);
+long bench_reach(Game *, long);
+long bench_rotate(Game *, long);
+void fixture_holes(Board *, Rng *);
+void fixture_nearly_full(Board *, Rng *);
+void fixture_set(Board *, int, int);
+double now();
+void report(bool *, const char *, const char *, int, BenchFunction, Game *);
+
+
+long bench_board_copy(Game *g, long n) {
+    Board saved = g->board;
+    long sum = 0;
+    for (long i = 0; i < n; i++) {
+        g->board = saved;
+        __asm__ volatile("" : : "r"(&g->board) : "memory");
+        sum += g->board.rows[i % BOARD_HEIGHT];
+    }
+    return sum;
+}
+
+
+/* drop random pieces at random columns until the board tops out, then start
+ * over, through the functions of a size picked at run time */
+long bench_board_drop(Game *g, long n) {
+    AnyBoard b;
+    int width = gBenchOps->width;
+    Rng rng;
+    long rows = 0;
+
+    rng_seed(&rng, BENCH_SEED);
+    gBenchOps->init(&b);
+    for (long i = 0; i < n; i++) {
+        int shape = rng_below(&rng, NPIECES) + 1;
+        const Rotation *r = &PIECE_ROTATIONS[shape - 1][rng_below(&rng, NROTATIONS)];
+        int x = rng_below(&rng, width - r->maxx + r->minx) - r->minx;
+        int cleared = gBenchOps->drop(&b, r->rows, x, shape);
+        if (cleared < 0) {
+            gBenchOps->init(&b);
+            continue;
+        }
+        rows += cleared;
+    }
+    return rows;
+}
+
+
+/* the same on the game board with direct calls, for the cost of picking the
+ * size at run time */
+long bench_board_drop_direct(Game *g, long n) {
+    Board b;
+    Rng rng;
+    long rows = 0;
+
+    rng_seed(&rng, BENCH_SEED);
+    board_init(&b);
+    for (long i = 0; i < n; i++) {
+        int shape = rng_below(&rng, NPIECES) + 1;
+        const Rotation *r = &PIECE_ROTATIONS[shape - 1][rng_below(&rng, NROTATIONS)];
+        int x = rng_below(&rng, BOARD_WIDTH - r->maxx + r->minx) - r->minx;
+        int cleared = board_drop(&b, r->rows, x, shape);
+        if (cleared < 0) {
+            board_init(&b);
+            continue;
+        }
+        rows += cleared;
+    }
+    return rows;
+}
+
+
+/* what the renderer or a serializer reads: the locked cells with the
+ * falling piece laid over them */
+long bench_cells(Game *g, long n) {
+    uint8_t cells[BOARD_HEIGHT][BOARD_WIDTH];
+    Piece *p = &g->current_piece;
+    long sum = 0;
+    for (long i = 0; i < n; i++) {
+        p->rotation = i % NROTATIONS;
+        playfield_cells(g, cells);
+        sum += cells[p->posy + 2][8];
+    }
+    return sum;
+}
+
+
+/* test every orientation of every shape at every position of the top half of
+ * the board */
+long bench_collided(Game *g, long n) {
+    long hits = 0;
+    Piece p = {I, 0, 0, 0, 0, 0, false};
+    for (long i = 0; i < n; i++) {
+        p.shape = i % NPIECES + 1;
+        p.rotation = (i / NPIECES) % NROTATIONS;
+        p.posx = (i / (NPIECES * NROTATIONS)) % PLACEMENT_COLUMNS + PLACEMENT_MIN_X;
+        p.posy = (i / (NPIECES * NROTATIONS * PLACEMENT_COLUMNS)) % (BOARD_HEIGHT / 2);
+        hits += piece_collided(g, &p);
+    }
+    return hits;
+}
+
+
+/* the board is copied back before each call so that there is always
+ * something to clear, board_copy gives the cost of the copy alone */
+long bench_drop_full_rows(Game *g, long n) {
+    Board saved = g->board;
+    long rows = 0;
+    for (long i = 0; i < n; i++) {
+        g->board = saved;
+        rows += playfield_drop_full_rows(g);
+    }
+    g->board = saved;
+    return rows;
+}
+
+
+long bench_games(Game *g, long n) {
+    long pieces = 0;
+    for (long i = 0; i < n; i++) {
+        Game game;
+        game_init(&game, BENCH_SEED + i, RANDOMIZER_UNIFORM);
+        while (!game.over && game.pieces_spawned < 10000 && placement_greedy(&game)) {
+        }
+        pieces += game.pieces_spawned;
+    }
+    return pieces;
+}
+
+
+long bench_placement_scan(Game *g, long n) {
+    Placements placements;
+    long sum = 0;
+    for (long i = 0; i < n; i++) {
+        placement_scan(&g->board, i % NPIECES + 1, 0, &placements);
+        sum += placements.row[i % NROTATIONS][8];
+    }
+    return sum;
+}
+
+
+/* every shape from the spawn position */
+long bench_reach(Game *g, long n) {
+    static Reach reach;
+    Piece start = {I, 0, 6, 0, 0, 0, false};
+    long sum = 0;
+    for (long i = 0; i < n; i++) {
+        start.shape = i % NPIECES + 1;
+        reach_search(&g->board, &start, &reach);
+        sum += reach.nplacements;
+    }
+    return sum;
+}
+
+
+/* counts one clockwise and one anticlockwise rotation as two operations */
+long bench_rotate(Game *g, long n) {
+    Piece *p = &g->current_piece;
+    long collisions = 0;
+    for (long i = 0; i < n; i += 2) {
+        collisions += piece_rotate_clock(g, p);
+        collisions += piece_rotate_anticlock(g, p);
+        p->rotation = (p->rotation + 1) % NROTATIONS;
+    }
+    return collisions;
+}
+
+
+/* rows 8 and below are 60% filled at random, leaving holes under the surface */
+void fixture_holes(Board *b, Rng *rng) {
+    board_init(b);
+    for (int i = 8; i < BOARD_HEIGHT; i++) {
+        for (int j = 0; j < BOARD_WIDTH; j++) {
+            if (rng_below(rng, 10) < 6) {
+                fixture_set(b, i, j);
+            }
+        }
+    }
+}
+
+
+/* all but the top 4 rows are full except for one hole each, the 4 bottom
+ * rows are full so that there is something to clear */
+void fixture_nearly_full(Board *b, Rng *rng) {
+    board_init(b);
+    for (int i = BOARD_PIECE_ROWS; i < BOARD_HEIGHT; i++) {
+        int hole = i < BOARD_HEIGHT - 4 ? (int) rng_below(rng, BOARD_WIDTH) : -1;
+        for (int j = 0; j < BOARD_WIDTH; j++) {
+            if (j != hole) {
+                fixture_set(b, i, j);
+            }
+        }
+    }
+}
+
+
+void fixture_set(Board *b, int i, int j) {
+    uint16_t cell[BOARD_PIECE_ROWS] = {1, 0, 0, 0};
+    board_add(b, cell, j, i, T);
+}
+
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* time fn with a growing number of operations until one run takes long
+ * enough, then print it as a JSON object */
+void report(
+    bool *first,
+    const char *name,
+    const char *fixture,
+    int ops_per_call,
+    BenchFunction fn,
+    Game *g
+) {
+    static volatile long sink;
+    long n = ops_per_call;
+    double elapsed;
+
+    for (;;) {
+        double start = now();
+        sink += fn(g, n);
+        elapsed = now() - start;
+        if (elapsed >= BENCH_MIN_SECONDS) {
+            break;
+        }
+        n *= elapsed > 0 ? 2 : 16;
+    }
+    printf(
+        "%s\n    {\"name\": \"%s\", \"fixture\": \"%s\", \"iterations\": %ld, "
+        "\"seconds\": %.6f, \"ns_per_op\": %.3f, \"ops_per_sec\": %.1f}",
+        *first ? "" : ",",
+        name,
+        fixture,
+        n,
+        elapsed,
+        elapsed * 1e9 / n,
+        n / elapsed
+    );
+    *first = false;
+}
+
+
+int main(int argc, char *argv[]) {
+    Fixture fixtures[NFIXTURES];
+    Rng rng;
+    Game g;
+    bool first = true;
+
+    rng_seed(&rng, BENCH_SEED);
+    fixtures[0].name = "empty";
+    board_init(&fixtures[0].board);
+    fixtures[1].name = "nearly_full";
+    fixture_nearly_full(&fixtures[1].board, &rng);
+    fixtures[2].name = "holes";
+    fixture_holes(&fixtures[2].board, &rng);
+
+    printf("{\n  \"placement_kernel\": \"%s\",\n", placement_kernel_name());
+    printf("  \"benchmarks\": [");
+    for (int f = 0; f < NFIXTURES; f++) {
+        game_init(&g, BENCH_SEED, RANDOMIZER_UNIFORM);
+        g.board = fixtures[f].board;
+        g.current_piece.shape = T;
+        g.current_piece.posy = 0;
+        report(&first, "piece_collided", fixtures[f].name, 1, bench_collided, &g);
+        report(&first, "piece_rotate", fixtures[f].name, 2, bench_rotate, &g);
+        report(&first, "playfield_cells", fixtures[f].name, 1, bench_cells, &g);
+        report(&first, "playfield_drop_full_rows", fixtures[f].name, 1, bench_drop_full_rows, &g);
+        report(&first, "board_copy", fixtures[f].name, 1, bench_board_copy, &g);
+        report(&first, "placement_scan", fixtures[f].name, 1, bench_placement_scan, &g);
+        report(&first, "reach_search", fixtures[f].name, 1, bench_reach, &g);
+    }
+    for (int s = 0; s < NBOARD_SIZES; s++) {
+        gBenchOps = BOARD_SIZES[s];
+        report(&first, "board_drop", gBenchOps->name, 1, bench_board_drop, &g);
+    }
+    report(&first, "board_drop_direct", board_ops.name, 1, bench_board_drop_direct, &g);
+    double start = now();
+    long pieces = bench_games(&g, BENCH_GAMES);
+    double elapsed = now() - start;
+    printf(
+        ",\n    {\"name\": \"headless_games\", \"fixture\": \"greedy\", \"games\": %d, "
+        "\"pieces\": %ld, \"seconds\": %.6f, \"games_per_sec\": %.1f, "
+        "\"pieces_per_sec\": %.1f}",
+        BENCH_GAMES,
+        pieces,
+        elapsed,
+        BENCH_GAMES / elapsed,
+        pieces / elapsed
+    );
+    printf("\n  ]\n}\n");
+    return 0;
+}
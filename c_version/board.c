@@ -0,0 +1,48 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "board.h"
+
+
+#define BOARD_VARIANT_NAME board
+#define BOARD_VARIANT_TYPE Board
+#define BOARD_VARIANT_WIDTH BOARD_WIDTH
+#define BOARD_VARIANT_HEIGHT BOARD_HEIGHT
+#define BOARD_VARIANT_DEFINITIONS
+#include "board_variant.h"
+#undef BOARD_VARIANT_DEFINITIONS
+
+
+/* copy the cells of the board into cells with a piece laid over them, the
+ * board itself is left untouched */
+void board_overlay(
+    const Board *b,
+    const uint16_t *rows,
+    int x,
+    int y,
+    int shape,
+    uint8_t cells[][BOARD_WIDTH]
+) {
+    memcpy(cells, b->cells, sizeof(b->cells));
+    for (int i = 0; i < BOARD_PIECE_ROWS && y + i < BOARD_HEIGHT; i++) {
+        uint32_t m = ((uint32_t) rows[i] << (x + BOARD_PAD)) >> BOARD_PAD;
+        m &= BOARD_ROW_FULL;
+        while (m != 0) {
+            cells[y + i][__builtin_ctz(m)] = shape;
+            m &= m - 1;
+        }
+    }
+}
+
+
+void board_print(const uint8_t cells[][BOARD_WIDTH]) {
+    printf("\n");
+    for (int i = 0; i < BOARD_HEIGHT; i++) {
+        for (int j = 0; j < BOARD_WIDTH; j++) {
+            printf("%d", cells[i][j]);
+        }
+        printf("\n");
+    }
+}
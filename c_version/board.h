@@ -0,0 +1,72 @@
+#ifndef __board_h__
+#define __board_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define BOARD_WIDTH 16
+#define BOARD_HEIGHT 24
+#define BOARD_PIECE_ROWS 4  /* rows covered by a piece mask */
+#define BOARD_ROW_FULL 0xFFFF
+/* piece masks are shifted into a 32-bit word with this many padding bits on
+ * the left so that cells falling off either side land on the walls */
+#define BOARD_PAD 4
+#define BOARD_WALLS (~((uint32_t) BOARD_ROW_FULL << BOARD_PAD))
+
+
+/* the functions of one board size behind pointers taking any board, for
+ * playing on a size picked at run time; each call runs a whole kernel
+ * compiled for that size so that the indirection stays out of the inner
+ * loops */
+typedef struct board_ops {
+    const char *name;  /* "WIDTHxHEIGHT" */
+    int width;
+    int height;
+    size_t size;  /* bytes of a board */
+    void (*add)(void *, const uint16_t *, int, int, int);
+    int (*clears)(const void *, const uint16_t *, int, int);
+    bool (*collided)(const void *, const uint16_t *, int, int);
+    int (*drop)(void *, const uint16_t *, int, int);
+    int (*drop_full_rows)(void *);
+    void (*init)(void *);
+} BoardOps;
+
+
+/* Zobrist key of row i holding the given mask, the hash of a board is the
+ * xor of the keys of its rows; rather than one random key per cell, the key
+ * of a whole row is a mix of its index and mask, which is just as good and
+ * needs no table; empty rows have key 0 so the empty board hashes to 0 */
+static inline uint64_t board_row_key(int i, uint32_t row) {
+    uint64_t z = ((uint64_t) i << 16 | row) * 0x9E3779B97F4A7C15;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    z ^= z >> 31;
+    return row == 0 ? 0 : z;
+}
+
+
+/* the same for rows of more than 16 cells, whose masks would run into the
+ * index, the index gets its own multiplier instead */
+static inline uint64_t board_row_key_wide(int i, uint64_t row) {
+    uint64_t z = row * 0x9E3779B97F4A7C15 + (uint64_t) (i + 1) * 0xD6E8FEB86659FD93;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    z ^= z >> 31;
+    return row == 0 ? 0 : z;
+}
+
+
+/* the board of the game, the other sizes are in boards.h */
+#define BOARD_VARIANT_NAME board
+#define BOARD_VARIANT_TYPE Board
+#define BOARD_VARIANT_WIDTH BOARD_WIDTH
+#define BOARD_VARIANT_HEIGHT BOARD_HEIGHT
+#include "board_variant.h"
+
+
+void board_overlay(const Board *, const uint16_t *, int, int, int, uint8_t [][BOARD_WIDTH]);
+void board_print(const uint8_t [][BOARD_WIDTH]);
+
+#endif
@@ -0,0 +1,243 @@
+/* a board of one size, included once per size with these defined:
+ *
+ *   BOARD_VARIANT_NAME    prefix of its functions, e.g. board10x20
+ *   BOARD_VARIANT_TYPE    name of its type, e.g. Board10x20
+ *   BOARD_VARIANT_WIDTH   number of columns, at most 64
+ *   BOARD_VARIANT_HEIGHT  number of rows
+ *
+ * which gives the type, its collision test and the prototypes of its other
+ * functions, or their definitions when BOARD_VARIANT_DEFINITIONS is defined
+ * too (in a single source file per size). Rows are held in the smallest word
+ * that fits them, and the sizes are constants in every function so that each
+ * size gets the code a build dedicated to it would get. The parameters are
+ * undefined at the end so that the next size can follow right away; needs
+ * board.h for BOARD_PIECE_ROWS, BOARD_PAD, the row keys and BoardOps */
+
+#define BOARD_VARIANT_CAT_(a, b) a##b
+#define BOARD_VARIANT_CAT(a, b) BOARD_VARIANT_CAT_(a, b)
+#define BOARD_VARIANT_FN(f) BOARD_VARIANT_CAT(BOARD_VARIANT_NAME, f)
+#define BOARD_VARIANT_STR_(w, h) #w "x" #h
+#define BOARD_VARIANT_STR(w, h) BOARD_VARIANT_STR_(w, h)
+
+/* row masks are shifted into a word BOARD_PAD bits wider on each side
+ * before they are tested against the walls */
+#if BOARD_VARIANT_WIDTH <= 16
+#define BOARD_VARIANT_ROW uint16_t
+#define BOARD_VARIANT_WIDE uint32_t
+#define BOARD_VARIANT_KEY board_row_key
+#elif BOARD_VARIANT_WIDTH <= 32
+#define BOARD_VARIANT_ROW uint32_t
+#define BOARD_VARIANT_WIDE uint64_t
+#define BOARD_VARIANT_KEY board_row_key_wide
+#else
+#define BOARD_VARIANT_ROW uint64_t
+#define BOARD_VARIANT_WIDE unsigned __int128
+#define BOARD_VARIANT_KEY board_row_key_wide
+#endif
+#define BOARD_VARIANT_FULL ((BOARD_VARIANT_ROW) (((BOARD_VARIANT_WIDE) 1 << BOARD_VARIANT_WIDTH) - 1))
+#define BOARD_VARIANT_WALLS (~((BOARD_VARIANT_WIDE) BOARD_VARIANT_FULL << BOARD_PAD))
+
+
+#ifndef BOARD_VARIANT_DEFINITIONS
+
+/* bit j of rows[i] is set if cell (i, j) is occupied, cells[i][j] keeps the
+ * shape that occupies it (0 if empty) for rendering only, collision and line
+ * clears only ever look at the masks; the board only holds locked pieces,
+ * the falling one is laid over it by whoever needs both */
+typedef struct BOARD_VARIANT_NAME {
+    /* rows past the bottom are kept full so that the floor is just another
+     * row and does not need a bounds test */
+    BOARD_VARIANT_ROW rows[BOARD_VARIANT_HEIGHT + BOARD_PIECE_ROWS];
+    uint8_t cells[BOARD_VARIANT_HEIGHT][BOARD_VARIANT_WIDTH];
+    uint64_t hash;  /* Zobrist hash of the rows, kept up to date by every change */
+    uint32_t generation;  /* bumped by every change, a copy with the same one is up to date */
+} BOARD_VARIANT_TYPE;
+
+
+extern const BoardOps BOARD_VARIANT_FN(_ops);
+
+
+void BOARD_VARIANT_FN(_add)(BOARD_VARIANT_TYPE *, const uint16_t *, int, int, int);
+int BOARD_VARIANT_FN(_clears)(const BOARD_VARIANT_TYPE *, const uint16_t *, int, int);
+int BOARD_VARIANT_FN(_drop)(BOARD_VARIANT_TYPE *, const uint16_t *, int, int);
+int BOARD_VARIANT_FN(_drop_full_rows)(BOARD_VARIANT_TYPE *);
+void BOARD_VARIANT_FN(_init)(BOARD_VARIANT_TYPE *);
+
+
+/* rows holds the BOARD_PIECE_ROWS masks of a piece (bit j is column j of the
+ * piece matrix), x and y are the position of its top left corner */
+static inline bool BOARD_VARIANT_FN(_collided)(
+    const BOARD_VARIANT_TYPE *b,
+    const uint16_t *rows,
+    int x,
+    int y
+) {
+    if (x < -BOARD_PAD || x > BOARD_VARIANT_WIDTH || y < 0 || y > BOARD_VARIANT_HEIGHT) {
+        return true;
+    }
+    BOARD_VARIANT_WIDE hit = 0;
+    for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+        BOARD_VARIANT_WIDE m = (BOARD_VARIANT_WIDE) rows[i] << (x + BOARD_PAD);
+        hit |= (m & BOARD_VARIANT_WALLS) | ((m >> BOARD_PAD) & b->rows[y + i]);
+    }
+    return hit != 0;
+}
+
+#else
+
+static void BOARD_VARIANT_FN(_ops_add)(void *, const uint16_t *, int, int, int);
+static int BOARD_VARIANT_FN(_ops_clears)(const void *, const uint16_t *, int, int);
+static bool BOARD_VARIANT_FN(_ops_collided)(const void *, const uint16_t *, int, int);
+static int BOARD_VARIANT_FN(_ops_drop)(void *, const uint16_t *, int, int);
+static int BOARD_VARIANT_FN(_ops_drop_full_rows)(void *);
+static void BOARD_VARIANT_FN(_ops_init)(void *);
+
+
+const BoardOps BOARD_VARIANT_FN(_ops) = {
+    BOARD_VARIANT_STR(BOARD_VARIANT_WIDTH, BOARD_VARIANT_HEIGHT),
+    BOARD_VARIANT_WIDTH,
+    BOARD_VARIANT_HEIGHT,
+    sizeof(BOARD_VARIANT_TYPE),
+    BOARD_VARIANT_FN(_ops_add),
+    BOARD_VARIANT_FN(_ops_clears),
+    BOARD_VARIANT_FN(_ops_collided),
+    BOARD_VARIANT_FN(_ops_drop),
+    BOARD_VARIANT_FN(_ops_drop_full_rows),
+    BOARD_VARIANT_FN(_ops_init)
+};
+
+
+/* set the cells covered by a piece mask, shape is stored for rendering */
+void BOARD_VARIANT_FN(_add)(BOARD_VARIANT_TYPE *b, const uint16_t *rows, int x, int y, int shape) {
+    for (int i = 0; i < BOARD_PIECE_ROWS && y + i < BOARD_VARIANT_HEIGHT; i++) {
+        BOARD_VARIANT_ROW m = ((BOARD_VARIANT_WIDE) rows[i] << (x + BOARD_PAD)) >> BOARD_PAD;
+        m &= BOARD_VARIANT_FULL;
+        if (m == 0) {
+            continue;
+        }
+        b->hash ^= BOARD_VARIANT_KEY(y + i, b->rows[y + i]) ^ BOARD_VARIANT_KEY(y + i, b->rows[y + i] | m);
+        b->rows[y + i] |= m;
+        while (m != 0) {
+            b->cells[y + i][__builtin_ctzll(m)] = shape;
+            m &= m - 1;
+        }
+    }
+    b->generation++;
+}
+
+
+/* the number of rows a piece mask would fill if it was locked at x and y,
+ * without changing the board */
+int BOARD_VARIANT_FN(_clears)(const BOARD_VARIANT_TYPE *b, const uint16_t *rows, int x, int y) {
+    int nrows = 0;
+
+    for (int i = 0; i < BOARD_PIECE_ROWS && y + i < BOARD_VARIANT_HEIGHT; i++) {
+        BOARD_VARIANT_ROW m = ((BOARD_VARIANT_WIDE) rows[i] << (x + BOARD_PAD)) >> BOARD_PAD;
+        m &= BOARD_VARIANT_FULL;
+        if (m != 0 && (b->rows[y + i] | m) == BOARD_VARIANT_FULL) {
+            nrows++;
+        }
+    }
+    return nrows;
+}
+
+
+/* drop a piece mask straight down from the top at column x, lock it and
+ * remove the rows it fills, return the number of rows removed or -1 if the
+ * piece does not fit at the top */
+int BOARD_VARIANT_FN(_drop)(BOARD_VARIANT_TYPE *b, const uint16_t *rows, int x, int shape) {
+    int y = 0;
+
+    if (BOARD_VARIANT_FN(_collided)(b, rows, x, y)) {
+        return -1;
+    }
+    while (!BOARD_VARIANT_FN(_collided)(b, rows, x, y + 1)) {
+        y++;
+    }
+    BOARD_VARIANT_FN(_add)(b, rows, x, y, shape);
+    return BOARD_VARIANT_FN(_drop_full_rows)(b);
+}
+
+
+/* remove full rows and move the rows above them down, return the number of
+ * rows removed */
+int BOARD_VARIANT_FN(_drop_full_rows)(BOARD_VARIANT_TYPE *b) {
+    int nrows = 0;
+    int k = BOARD_VARIANT_HEIGHT - 1;  /* where the next kept row goes */
+
+    for (int i = BOARD_VARIANT_HEIGHT - 1; i >= 0; i--) {
+        if (b->rows[i] == BOARD_VARIANT_FULL) {
+            nrows++;
+            continue;
+        }
+        if (k != i) {
+            b->hash ^= BOARD_VARIANT_KEY(k, b->rows[k]) ^ BOARD_VARIANT_KEY(k, b->rows[i]);
+            b->rows[k] = b->rows[i];
+            memcpy(b->cells[k], b->cells[i], BOARD_VARIANT_WIDTH);
+        }
+        k--;
+    }
+    for (; k >= 0; k--) {
+        b->hash ^= BOARD_VARIANT_KEY(k, b->rows[k]);
+        b->rows[k] = 0;
+        memset(b->cells[k], 0, BOARD_VARIANT_WIDTH);
+    }
+    if (nrows > 0) {
+        b->generation++;
+    }
+    return nrows;
+}
+
+
+void BOARD_VARIANT_FN(_init)(BOARD_VARIANT_TYPE *b) {
+    for (int i = 0; i < BOARD_VARIANT_HEIGHT; i++) {
+        b->rows[i] = 0;
+    }
+    for (int i = BOARD_VARIANT_HEIGHT; i < BOARD_VARIANT_HEIGHT + BOARD_PIECE_ROWS; i++) {
+        b->rows[i] = BOARD_VARIANT_FULL;
+    }
+    memset(b->cells, 0, sizeof(b->cells));
+    b->hash = 0;
+    b->generation = 0;
+}
+
+
+static void BOARD_VARIANT_FN(_ops_add)(void *b, const uint16_t *rows, int x, int y, int shape) {
+    BOARD_VARIANT_FN(_add)(b, rows, x, y, shape);
+}
+
+
+static int BOARD_VARIANT_FN(_ops_clears)(const void *b, const uint16_t *rows, int x, int y) {
+    return BOARD_VARIANT_FN(_clears)(b, rows, x, y);
+}
+
+
+static bool BOARD_VARIANT_FN(_ops_collided)(const void *b, const uint16_t *rows, int x, int y) {
+    return BOARD_VARIANT_FN(_collided)(b, rows, x, y);
+}
+
+
+static int BOARD_VARIANT_FN(_ops_drop)(void *b, const uint16_t *rows, int x, int shape) {
+    return BOARD_VARIANT_FN(_drop)(b, rows, x, shape);
+}
+
+
+static int BOARD_VARIANT_FN(_ops_drop_full_rows)(void *b) {
+    return BOARD_VARIANT_FN(_drop_full_rows)(b);
+}
+
+
+static void BOARD_VARIANT_FN(_ops_init)(void *b) {
+    BOARD_VARIANT_FN(_init)(b);
+}
+
+#endif
+
+
+#undef BOARD_VARIANT_NAME
+#undef BOARD_VARIANT_TYPE
+#undef BOARD_VARIANT_WIDTH
+#undef BOARD_VARIANT_HEIGHT
+#undef BOARD_VARIANT_ROW
+#undef BOARD_VARIANT_WIDE
+#undef BOARD_VARIANT_KEY
@@ -0,0 +1,44 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "boards.h"
+
+
+#define BOARD_VARIANT_DEFINITIONS
+
+#define BOARD_VARIANT_NAME board10x20
+#define BOARD_VARIANT_TYPE Board10x20
+#define BOARD_VARIANT_WIDTH 10
+#define BOARD_VARIANT_HEIGHT 20
+#include "board_variant.h"
+
+#define BOARD_VARIANT_NAME board32x32
+#define BOARD_VARIANT_TYPE Board32x32
+#define BOARD_VARIANT_WIDTH 32
+#define BOARD_VARIANT_HEIGHT 32
+#include "board_variant.h"
+
+#define BOARD_VARIANT_NAME board64x32
+#define BOARD_VARIANT_TYPE Board64x32
+#define BOARD_VARIANT_WIDTH 64
+#define BOARD_VARIANT_HEIGHT 32
+#include "board_variant.h"
+
+#undef BOARD_VARIANT_DEFINITIONS
+
+
+const BoardOps *BOARD_SIZES[NBOARD_SIZES] = {
+    &board10x20_ops, &board_ops, &board32x32_ops, &board64x32_ops
+};
+
+
+/* the functions for boards of the given size, NULL if it was not compiled in */
+const BoardOps *board_ops_find(int width, int height) {
+    for (int i = 0; i < NBOARD_SIZES; i++) {
+        if (BOARD_SIZES[i]->width == width && BOARD_SIZES[i]->height == height) {
+            return BOARD_SIZES[i];
+        }
+    }
+    return NULL;
+}
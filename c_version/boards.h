@@ -0,0 +1,51 @@
+#ifndef __boards_h__
+#define __boards_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+
+
+/* boards of other sizes than the game's, a game plays on any of them
+ * through their BoardOps */
+#define NBOARD_SIZES 4
+
+
+/* the standard playfield */
+#define BOARD_VARIANT_NAME board10x20
+#define BOARD_VARIANT_TYPE Board10x20
+#define BOARD_VARIANT_WIDTH 10
+#define BOARD_VARIANT_HEIGHT 20
+#include "board_variant.h"
+
+/* wide playfields, rows of 32 and 64 cells */
+#define BOARD_VARIANT_NAME board32x32
+#define BOARD_VARIANT_TYPE Board32x32
+#define BOARD_VARIANT_WIDTH 32
+#define BOARD_VARIANT_HEIGHT 32
+#include "board_variant.h"
+
+#define BOARD_VARIANT_NAME board64x32
+#define BOARD_VARIANT_TYPE Board64x32
+#define BOARD_VARIANT_WIDTH 64
+#define BOARD_VARIANT_HEIGHT 32
+#include "board_variant.h"
+
+
+/* room for a board of any of the sizes */
+typedef union any_board {
+    Board10x20 board10x20;
+    Board board;
+    Board32x32 board32x32;
+    Board64x32 board64x32;
+} AnyBoard;
+
+
+/* every size compiled in, from the narrowest, the game board among them */
+extern const BoardOps *BOARD_SIZES[NBOARD_SIZES];
+
+
+const BoardOps *board_ops_find(int, int);
+
+#endif
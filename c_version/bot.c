@@ -0,0 +1,363 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "bot.h"
+#include "debug.h"
+#include "engine.h"
+#include "reach.h"
+#include "threadpool.h"
+#include "tt.h"
+
+
+/* kinds of transposition table entries, xored into the board hash */
+#define KEY_EVALUATION 0x6A09E667F3BCC908
+#define KEY_MOVE 0xBB67AE8584CAA73B
+
+
+/* a board kept in the beam, root is the placement of the current piece it
+ * comes from */
+typedef struct node {
+    Board board;
+    int lines;  /* cleared on the way from the current board */
+    int value;
+    int root;
+} Node;
+
+/* a placement of the next piece on a board of the beam, only turned into a
+ * board if it makes it into the next beam */
+typedef struct child {
+    int parent;
+    int order;  /* index among the children of the parent, breaks ties */
+    int value;
+    int lines;
+    uint64_t hash;  /* of the board it leads to */
+    ReachPlacement placement;
+} Child;
+
+struct bot {
+    Pool *pool;
+    int depth;
+    int width;
+    int shape;  /* shape placed by the level being expanded */
+    Reach root;  /* placements of the current piece, for the paths */
+    Reach *reach;  /* scratch for each thread of the pool */
+    Node *beam;
+    int nbeam;
+    Node *next;
+    Child *children;  /* REACH_STATES per node of the beam */
+    int *nchildren;
+    Child *ranked;
+    TT *tt;  /* evaluations of boards and moves chosen, shared by the threads */
+};
+
+
+void bot_stats(Bot *bot, TTStats *stats) {
+    tt_stats(bot->tt, stats);
+}
+
+
+static void apply(const Board *, int, const ReachPlacement *, Board *, int *);
+static int compare_children(const void *, const void *);
+static int evaluate_cached(Bot *, int, const Board *);
+static void expand(void *, int64_t, int);
+static uint64_t move_key(const Board *, const int *, int);
+static int rank_children(Bot *);
+static void score_child(Bot *, int, const Node *, const ReachPlacement *, Child *);
+static int search(Bot *, const Game *, const int *);
+
+
+/* pick where to lock the current piece with a beam search over it and the
+ * next depth - 1 pieces, which the bot knows the way a preview would show
+ * them; returns false if the piece cannot be placed anywhere */
+bool bot_choose(Bot *bot, const Game *g, BotMove *move) {
+    int shapes[BOT_MAX_DEPTH];
+    Game preview = *g;
+
+    shapes[0] = g->current_piece.shape;
+    for (int i = 1; i < bot->depth; i++) {
+        shapes[i] = piece_next_shape(&preview);
+    }
+
+    reach_search(&g->board, &g->current_piece, &bot->root);
+    if (bot->root.nplacements == 0) {
+        return false;
+    }
+
+    /* the same board with the same pieces to come was searched before; this
+     * thread is worker 0 of the pool */
+    uint64_t key = move_key(&g->board, shapes, bot->depth);
+    uint64_t data;
+    int chosen = -1;
+    if (tt_probe(bot->tt, 0, key, &data)) {
+        for (int i = 0; i < bot->root.nplacements; i++) {
+            if (bot->root.placements[i].rotation == (int8_t) (data >> 16)
+                && bot->root.placements[i].posx == (int8_t) (data >> 8)
+                && bot->root.placements[i].posy == (int8_t) data) {
+                chosen = i;
+                break;
+            }
+        }
+    }
+    if (chosen < 0) {
+        chosen = search(bot, g, shapes);
+        ReachPlacement *p = &bot->root.placements[chosen];
+        tt_store(
+            bot->tt,
+            0,
+            key,
+            TT_USED | (uint64_t) (uint8_t) p->rotation << 16 | (uint8_t) p->posx << 8 | (uint8_t) p->posy
+        );
+    }
+
+    move->placement = bot->root.placements[chosen];
+    move->length = reach_path(&bot->root, &move->placement, move->actions, BOT_MAX_PATH);
+    if (move->length > BOT_MAX_PATH) {
+        move->length = BOT_MAX_PATH;
+    }
+    return true;
+}
+
+
+/* higher is better, lines are the rows cleared to get to the board */
+int bot_evaluate(const Board *b, int lines) {
+    BotFeatures f;
+    bot_features(b, &f);
+    return BOT_WEIGHT_HEIGHT * f.height
+        + BOT_WEIGHT_LINES * lines
+        + BOT_WEIGHT_HOLES * f.holes
+        + BOT_WEIGHT_BUMPINESS * f.bumpiness;
+}
+
+
+/* one pass from the top keeping the union of the rows seen so far: a column
+ * is set in it from its highest cell down, so each row adds the columns set
+ * in the union to the heights, the columns set in the union and empty in the
+ * row to the holes, and the neighbour columns where exactly one is set in
+ * the union to the bumpiness */
+void bot_features(const Board *b, BotFeatures *f) {
+    uint32_t seen = 0;
+
+    f->height = 0;
+    f->holes = 0;
+    f->bumpiness = 0;
+    for (int i = 0; i < BOARD_HEIGHT; i++) {
+        f->holes += __builtin_popcount(seen & ~b->rows[i]);
+        seen |= b->rows[i];
+        f->height += __builtin_popcount(seen);
+        f->bumpiness += __builtin_popcount((seen ^ (seen >> 1)) & (BOARD_ROW_FULL >> 1));
+    }
+}
+
+
+void bot_free(Bot *bot) {
+    if (bot == NULL) {
+        return;
+    }
+    free(bot->reach);
+    free(bot->beam);
+    free(bot->next);
+    free(bot->children);
+    free(bot->nchildren);
+    free(bot->ranked);
+    tt_free(bot->tt);
+    free(bot);
+}
+
+
+/* everything the search needs is allocated here, choosing a move does not
+ * allocate */
+Bot *bot_new(Pool *pool, int depth, int width) {
+    Bot *bot = calloc(1, sizeof(Bot));
+    check_mem(bot);
+    check(depth >= 1 && depth <= BOT_MAX_DEPTH, "Search depth must be from 1 to %d", BOT_MAX_DEPTH);
+    check(width >= 1, "Beam width must be positive");
+    bot->pool = pool;
+    bot->depth = depth;
+    bot->width = width;
+    bot->reach = calloc(pool_size(pool), sizeof(Reach));
+    check_mem(bot->reach);
+    bot->beam = calloc(width, sizeof(Node));
+    check_mem(bot->beam);
+    bot->next = calloc(width, sizeof(Node));
+    check_mem(bot->next);
+    bot->children = calloc((size_t) width * REACH_STATES, sizeof(Child));
+    check_mem(bot->children);
+    bot->nchildren = calloc(width, sizeof(int));
+    check_mem(bot->nchildren);
+    bot->ranked = calloc((size_t) width * REACH_STATES, sizeof(Child));
+    check_mem(bot->ranked);
+    bot->tt = tt_new(BOT_TT_BITS, pool_size(pool));
+    check(bot->tt != NULL, "Failed to create transposition table");
+    return bot;
+
+    error:
+        bot_free(bot);
+        return NULL;
+}
+
+
+/* choose a move and lock the piece there, false if there was none */
+bool bot_play(Bot *bot, Game *g) {
+    BotMove move;
+    if (!bot_choose(bot, g, &move)) {
+        return false;
+    }
+    return game_place(g, move.placement.rotation, move.placement.posx, move.placement.posy);
+}
+
+
+static void apply(const Board *from, int shape, const ReachPlacement *p, Board *to, int *lines) {
+    *to = *from;
+    board_add(to, PIECE_ROTATIONS[shape - 1][p->rotation].rows, p->posx, p->posy, shape);
+    *lines = board_drop_full_rows(to);
+}
+
+
+/* best first, ties go to the earlier parent then the earlier placement so
+ * that the choice does not depend on the number of threads */
+static int compare_children(const void *a, const void *b) {
+    const Child *x = a, *y = b;
+    if (x->value != y->value) {
+        return x->value < y->value ? 1 : -1;
+    }
+    if (x->parent != y->parent) {
+        return x->parent - y->parent;
+    }
+    return x->order - y->order;
+}
+
+
+/* the part of the evaluation that only depends on the board */
+static int evaluate_cached(Bot *bot, int worker, const Board *b) {
+    uint64_t key = b->hash ^ KEY_EVALUATION;
+    uint64_t data;
+    if (tt_probe(bot->tt, worker, key, &data)) {
+        return (int32_t) data;
+    }
+    int value = bot_evaluate(b, 0);
+    tt_store(bot->tt, worker, key, TT_USED | (uint32_t) value);
+    return value;
+}
+
+
+/* task: score every placement of the next piece on one board of the beam */
+static void expand(void *arg, int64_t index, int worker) {
+    Bot *bot = arg;
+    Node *node = &bot->beam[index];
+    Reach *reach = &bot->reach[worker];
+    Child *children = &bot->children[index * REACH_STATES];
+    Piece spawn = {bot->shape, 0, PIECE_SPAWN_X, 0, 0, 0, false};
+
+    reach_search(&node->board, &spawn, reach);
+    for (int i = 0; i < reach->nplacements; i++) {
+        score_child(bot, worker, node, &reach->placements[i], &children[i]);
+        children[i].parent = index;
+        children[i].order = i;
+    }
+    bot->nchildren[index] = reach->nplacements;
+}
+
+
+/* key of the move chosen for a board, given the pieces the search sees */
+static uint64_t move_key(const Board *b, const int *shapes, int depth) {
+    uint64_t key = b->hash ^ KEY_MOVE;
+    for (int i = 0; i < depth; i++) {
+        key = (key ^ shapes[i]) * 0x9E3779B97F4A7C15;
+        key ^= key >> 29;
+    }
+    return key;
+}
+
+
+/* gather the children of all boards of the beam and keep the best width of
+ * them at the front of ranked, returns how many there are; a board reached
+ * through different move orders is only kept once */
+static int rank_children(Bot *bot) {
+    int n = 0, kept = 0;
+    for (int i = 0; i < bot->nbeam; i++) {
+        memcpy(&bot->ranked[n], &bot->children[i * REACH_STATES], bot->nchildren[i] * sizeof(Child));
+        n += bot->nchildren[i];
+    }
+    qsort(bot->ranked, n, sizeof(Child), compare_children);
+    for (int i = 0; i < n && kept < bot->width; i++) {
+        bool seen = false;
+        for (int j = 0; j < kept && !seen; j++) {
+            seen = bot->ranked[j].hash == bot->ranked[i].hash;
+        }
+        if (!seen) {
+            bot->ranked[kept++] = bot->ranked[i];
+        }
+    }
+    return kept;
+}
+
+
+/* value of the board after locking the piece; the placement is only made on
+ * a copy, boards where some shape could not spawn are losses */
+static void score_child(Bot *bot, int worker, const Node *node, const ReachPlacement *p, Child *child) {
+    Board board;
+    int lines;
+
+    apply(&node->board, bot->shape, p, &board, &lines);
+    child->placement = *p;
+    child->lines = node->lines + lines;
+    child->hash = board.hash;
+    child->value = evaluate_cached(bot, worker, &board) + BOT_WEIGHT_LINES * child->lines;
+    for (int s = 0; s < NPIECES; s++) {
+        if (board_collided(&board, PIECE_ROTATIONS[s][0].rows, PIECE_SPAWN_X, 0)) {
+            child->value = BOT_GAME_OVER;
+            break;
+        }
+    }
+}
+
+
+/* beam search from the placements of the current piece in bot->root,
+ * returns the index of the one leading to the best board */
+static int search(Bot *bot, const Game *g, const int *shapes) {
+    Node *root = &bot->beam[0];
+
+    /* the first level has a single board so it runs on this thread */
+    root->board = g->board;
+    root->lines = 0;
+    root->root = -1;
+    bot->nbeam = 1;
+    bot->shape = shapes[0];
+    for (int i = 0; i < bot->root.nplacements; i++) {
+        score_child(bot, 0, root, &bot->root.placements[i], &bot->children[i]);
+        bot->children[i].parent = 0;
+        bot->children[i].order = i;
+    }
+    bot->nchildren[0] = bot->root.nplacements;
+
+    for (int level = 0;; level++) {
+        int n = rank_children(bot);
+        if (n == 0) {
+            break;
+        }
+        /* turn the best children into the next beam */
+        for (int i = 0; i < n; i++) {
+            Child *c = &bot->ranked[i];
+            Node *parent = &bot->beam[c->parent];
+            Node *node = &bot->next[i];
+            int lines;
+            apply(&parent->board, bot->shape, &c->placement, &node->board, &lines);
+            node->lines = parent->lines + lines;
+            node->value = c->value;
+            node->root = level == 0 ? c->order : parent->root;
+        }
+        Node *swap = bot->beam;
+        bot->beam = bot->next;
+        bot->next = swap;
+        bot->nbeam = n;
+        if (level + 1 == bot->depth || bot->beam[0].value <= BOT_GAME_OVER) {
+            break;
+        }
+        bot->shape = shapes[level + 1];
+        pool_run(bot->pool, bot->nbeam, expand, bot);
+    }
+    return bot->beam[0].root;
+}
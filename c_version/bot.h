@@ -0,0 +1,50 @@
+#ifndef __bot_h__
+#define __bot_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "engine.h"
+#include "reach.h"
+#include "threadpool.h"
+#include "tt.h"
+
+
+#define BOT_DEFAULT_DEPTH 3  /* pieces looked at: the current one and the next ones */
+#define BOT_DEFAULT_WIDTH 16  /* boards kept after each piece */
+#define BOT_MAX_DEPTH 8
+#define BOT_MAX_PATH 255
+#define BOT_TT_BITS 18  /* 2^18 entries of the transposition table, 4 MiB */
+/* weights of the evaluation, per thousand */
+#define BOT_WEIGHT_HEIGHT (-510)
+#define BOT_WEIGHT_LINES 760
+#define BOT_WEIGHT_HOLES (-357)
+#define BOT_WEIGHT_BUMPINESS (-184)
+#define BOT_GAME_OVER (-1000000000)
+
+
+typedef struct bot_move {
+    ReachPlacement placement;
+    int length;
+    uint8_t actions[BOT_MAX_PATH];  /* inputs from the spawn position, ACTION_* */
+} BotMove;
+
+typedef struct bot_features {
+    int height;  /* sum of the column heights */
+    int holes;  /* empty cells with a filled one above */
+    int bumpiness;  /* sum of the height differences of neighbour columns */
+} BotFeatures;
+
+typedef struct bot Bot;
+
+
+bool bot_choose(Bot *, const Game *, BotMove *);
+int bot_evaluate(const Board *, int);
+void bot_features(const Board *, BotFeatures *);
+void bot_free(Bot *);
+Bot *bot_new(Pool *, int, int);
+bool bot_play(Bot *, Game *);
+void bot_stats(Bot *, TTStats *);
+
+#endif
@@ -0,0 +1,295 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+
+int POINTS[5] = {0, 50, 150, 350, 1000};
+
+
+static inline bool game_collided(const Game *, const uint16_t *, int, int);
+
+
+const Rotation PIECE_ROTATIONS[NPIECES][NROTATIONS] = {
+    {  /* I */
+        {{0x2, 0x2, 0x2, 0x2}, 1, 1, 0, 3},
+        {{0x0, 0xF, 0x0, 0x0}, 0, 3, 1, 1},
+        {{0x4, 0x4, 0x4, 0x4}, 2, 2, 0, 3},
+        {{0x0, 0x0, 0xF, 0x0}, 0, 3, 2, 2}
+    },
+    {  /* J */
+        {{0x4, 0x4, 0x6, 0x0}, 1, 2, 0, 2},
+        {{0x0, 0x2, 0xE, 0x0}, 1, 3, 1, 2},
+        {{0x0, 0x6, 0x2, 0x2}, 1, 2, 1, 3},
+        {{0x0, 0x7, 0x4, 0x0}, 0, 2, 1, 2}
+    },
+    {  /* L */
+        {{0x2, 0x2, 0x6, 0x0}, 1, 2, 0, 2},
+        {{0x0, 0xE, 0x2, 0x0}, 1, 3, 1, 2},
+        {{0x0, 0x6, 0x4, 0x4}, 1, 2, 1, 3},
+        {{0x0, 0x4, 0x7, 0x0}, 0, 2, 1, 2}
+    },
+    {  /* O */
+        {{0x0, 0x6, 0x6, 0x0}, 1, 2, 1, 2},
+        {{0x0, 0x6, 0x6, 0x0}, 1, 2, 1, 2},
+        {{0x0, 0x6, 0x6, 0x0}, 1, 2, 1, 2},
+        {{0x0, 0x6, 0x6, 0x0}, 1, 2, 1, 2}
+    },
+    {  /* S */
+        {{0x0, 0x6, 0x3, 0x0}, 0, 2, 1, 2},
+        {{0x2, 0x6, 0x4, 0x0}, 1, 2, 0, 2},
+        {{0x0, 0xC, 0x6, 0x0}, 1, 3, 1, 2},
+        {{0x0, 0x2, 0x6, 0x4}, 1, 2, 1, 3}
+    },
+    {  /* T */
+        {{0x0, 0x2, 0x7, 0x0}, 0, 2, 1, 2},
+        {{0x2, 0x6, 0x2, 0x0}, 1, 2, 0, 2},
+        {{0x0, 0xE, 0x4, 0x0}, 1, 3, 1, 2},
+        {{0x0, 0x4, 0x6, 0x4}, 1, 2, 1, 3}
+    },
+    {  /* Z */
+        {{0x0, 0x3, 0x6, 0x0}, 0, 2, 1, 2},
+        {{0x4, 0x6, 0x2, 0x0}, 1, 2, 0, 2},
+        {{0x0, 0x6, 0xC, 0x0}, 1, 3, 1, 2},
+        {{0x0, 0x4, 0x6, 0x2}, 1, 2, 1, 3}
+    }
+};
+
+
+/* turn the current piece to the given orientation, move it to column posx
+ * and drop it straight down, return false without changing anything if the
+ * piece does not fit there */
+bool game_drop(Game *g, int rotation, int posx) {
+    Piece *p = &g->current_piece;
+    Piece saved = *p;
+    p->rotation = rotation;
+    p->posx = posx;
+    if (piece_collided(g, p)) {
+        *p = saved;
+        return false;
+    }
+    const uint16_t *rows = piece_rotation(p)->rows;
+    while (!game_collided(g, rows, p->posx, p->posy + 1)) {
+        p->posy++;
+    }
+    p->landed = true;
+    g->events |= EVENT_PIECE_LANDED;
+    game_land(g);
+    return true;
+}
+
+
+void game_init(Game *g, uint64_t seed, int randomizer) {
+    game_init_size(g, &board_ops, seed, randomizer);
+}
+
+
+/* start a game on a board of the given size */
+void game_init_size(Game *g, const BoardOps *ops, uint64_t seed, int randomizer) {
+    g->ops = ops;
+    ops->init(&g->any_board);
+    g->seed = seed;
+    rng_seed(&g->rng, seed);
+    g->randomizer = randomizer;
+    g->bag_left = 0;
+    g->score = 0;
+    g->level = 1;
+    g->total_rows = 0;
+    g->pieces_spawned = 0;
+    g->events = 0;
+    g->over = false;
+    piece_spawn(g);
+}
+
+
+/* block the current piece where it landed, clear full rows, update score and
+ * level, then spawn the next piece */
+void game_land(Game *g) {
+    playfield_add_piece(g, &g->current_piece);
+    int nrows = playfield_drop_full_rows(g);
+    g->total_rows += nrows;
+    g->score += update_score(g->level, nrows);
+    if (nrows != 0 && update_level(g->level, g->total_rows)) {
+        g->level++;
+    }
+    /* if piece is spawned over anoter piece the game is over */
+    if (piece_collided(g, piece_spawn(g))) {
+        g->over = true;
+    }
+}
+
+
+/* lock the current piece at an exact spot, which must be one where it rests
+ * on something (as found by reach_search), return false if it is not */
+bool game_place(Game *g, int rotation, int posx, int posy) {
+    Piece *p = &g->current_piece;
+    Piece saved = *p;
+    p->rotation = rotation;
+    p->posx = posx;
+    p->posy = posy;
+    if (piece_collided(g, p) || !game_collided(g, piece_rotation(p)->rows, posx, posy + 1)) {
+        *p = saved;
+        return false;
+    }
+    p->landed = true;
+    g->events |= EVENT_PIECE_LANDED;
+    game_land(g);
+    return true;
+}
+
+
+/* milliseconds between two rows of gravity, 100 less per level down to 50 */
+uint32_t level_timer_ticks(int level) {
+    int ticks = 1000 - (level - 1) * 100;
+    if (ticks < 50) {
+        return 50;
+    }
+    return ticks;
+}
+
+
+bool piece_collided(Game *g, Piece *p) {
+    return game_collided(g, piece_rotation(p)->rows, p->posx, p->posy);
+}
+
+
+void piece_move(Game *g, Piece *p) {
+    /* move the piece left or right */
+    p->posx += p->velx;
+    /* if the piece collided or went too far left or right, move back */
+    if (piece_collided(g, p)) {
+        p->posx -= p->velx;
+    }
+    /* move the piece down */
+    p->posy += p->vely;
+    /* if the piece collided or went too far down, move back and record it as
+     * 'landed' (will be blocked and new piece will be spawned) */
+    if (piece_collided(g, p)) {
+        p->posy -= p->vely;
+        p->landed = true;
+        g->events |= EVENT_PIECE_LANDED;
+    }
+}
+
+
+int piece_next_shape(Game *g) {
+    if (g->randomizer != RANDOMIZER_BAG) {
+        return rng_below(&g->rng, NPIECES) + 1;
+    }
+    if (g->bag_left == 0) {
+        /* deal a new bag: every shape once, in shuffled order */
+        for (int i = 0; i < NPIECES; i++) {
+            int j = rng_below(&g->rng, i + 1);
+            g->bag[i] = g->bag[j];
+            g->bag[j] = i + 1;
+        }
+        g->bag_left = NPIECES;
+    }
+    return g->bag[--g->bag_left];
+}
+
+
+Piece *piece_spawn(Game *g) {
+    Piece *p = &g->current_piece;
+    p->shape = piece_next_shape(g);
+    p->rotation = 0;
+    p->posx = (g->ops->width - PIECE_MATRIX_WIDTH) / 2;
+    p->posy = 0;
+    p->velx = 0;
+    p->vely = 0;
+    p->landed = false;
+    g->pieces_spawned++;
+    return p;
+}
+
+
+bool piece_rotate_anticlock(Game *g, Piece *p) {
+    p->rotation = (p->rotation + NROTATIONS - 1) % NROTATIONS;
+    return piece_collided(g, p);
+}
+
+
+bool piece_rotate_clock(Game *g, Piece *p) {
+    p->rotation = (p->rotation + 1) % NROTATIONS;
+    return piece_collided(g, p);
+}
+
+
+/* lock a piece into the board, the only way a piece gets there */
+void playfield_add_piece(Game *g, Piece *piece) {
+    if (g->ops != &board_ops) {
+        g->ops->add(
+            &g->any_board,
+            piece_rotation(piece)->rows,
+            piece->posx,
+            piece->posy,
+            piece->shape
+        );
+        return;
+    }
+    board_add(
+        &g->board,
+        piece_rotation(piece)->rows,
+        piece->posx,
+        piece->posy,
+        piece->shape
+    );
+}
+
+
+int playfield_drop_full_rows(Game *g) {
+    int nrows = g->ops == &board_ops
+        ? board_drop_full_rows(&g->board)
+        : g->ops->drop_full_rows(&g->any_board);
+
+    switch (nrows) {
+        case 1:
+            g->events |= EVENT_CLEAR_ROW_ONE;
+            break;
+        case 2:
+            g->events |= EVENT_CLEAR_ROW_TWO;
+            break;
+        case 3:
+            g->events |= EVENT_CLEAR_ROW_THREE;
+            break;
+        case 4:
+            g->events |= EVENT_CLEAR_ROW_FOUR;
+            break;
+    }
+
+    return nrows;
+}
+
+
+/* the locked cells with the falling piece laid over them */
+void playfield_cells(const Game *g, uint8_t cells[][BOARD_WIDTH]) {
+    const Piece *p = &g->current_piece;
+    board_overlay(&g->board, piece_rotation(p)->rows, p->posx, p->posy, p->shape, cells);
+}
+
+
+void playfield_print(const Game *g) {
+    uint8_t cells[BOARD_HEIGHT][BOARD_WIDTH];
+    playfield_cells(g, cells);
+    board_print(cells);
+}
+
+
+bool update_level(int current_level, int total_rows) {
+    return total_rows >= current_level * FULL_ROWS_PER_LEVEL;
+}
+
+
+int update_score(int level, int nrows) {
+    return level * POINTS[nrows];
+}
+
+
+/* the game board is tested directly so that its collision test is inlined,
+ * other sizes go through their ops */
+static inline bool game_collided(const Game *g, const uint16_t *rows, int x, int y) {
+    if (g->ops == &board_ops) {
+        return board_collided(&g->board, rows, x, y);
+    }
+    return g->ops->collided(&g->any_board, rows, x, y);
+}
@@ -0,0 +1,115 @@
+#ifndef __engine_h__
+#define __engine_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "boards.h"
+#include "rng.h"
+
+
+#define PLAYFIELD_CELL_WIDTH BOARD_WIDTH
+#define PLAYFIELD_CELL_HEIGHT BOARD_HEIGHT
+#define PIECE_VELOCITY 1
+#define PIECE_SPAWN_X 6  /* posx of new pieces on the game board, they start at posy 0 */
+#define PIECE_MATRIX_WIDTH 4
+#define PIECE_MATRIX_HEIGHT 4
+#define NPIECES 7
+#define NROTATIONS 4
+#define FULL_ROWS_PER_LEVEL 8
+#define RULES_VERSION 3  /* bump when a change makes recorded games play out differently */
+
+
+enum SHAPES {I = 1, J, L, O, S, T, Z};
+
+/* how the next shape is picked: independently at random, or by dealing
+ * shuffled bags holding each of the NPIECES shapes once */
+enum RANDOMIZERS {RANDOMIZER_UNIFORM, RANDOMIZER_BAG};
+
+/* things that happened during a game step, the front end decides what to do
+ * with them (e.g. play a sound) and clears them */
+enum GAME_EVENTS {
+    EVENT_PIECE_LANDED = 1 << 0,
+    EVENT_CLEAR_ROW_ONE = 1 << 1,
+    EVENT_CLEAR_ROW_TWO = 1 << 2,
+    EVENT_CLEAR_ROW_THREE = 1 << 3,
+    EVENT_CLEAR_ROW_FOUR = 1 << 4
+};
+
+
+/* one orientation of a shape: its matrix as row masks (bit j is column j) and
+ * the bounding box of the occupied cells inside the matrix */
+typedef struct rotation {
+    uint16_t rows[PIECE_MATRIX_HEIGHT];
+    int8_t minx;
+    int8_t maxx;
+    int8_t miny;
+    int8_t maxy;
+} Rotation;
+
+typedef struct piece {
+    int shape; /* shape name */
+    int rotation;  /* orientation, index in PIECE_ROTATIONS[shape - 1] */
+    int posx;  /* x-position of top left corner of matrix */
+    int posy;  /* y-position of top left corner of matrix */
+    int velx;  /* velocity along the x-axis */
+    int vely;  /* velocity along the y-axis */
+    bool landed;  /* if piece lands on bottom of playfield or another piece */
+} Piece;
+
+/* complete state of one game, games do not share anything so several of them
+ * can run side by side in the same process */
+typedef struct game {
+    /* a game on the game board uses board, on another size any_board holds
+     * it and only ops reaches it; the bot, replays, the front ends and
+     * playfield_cells only play on the game board */
+    union {
+        Board board;
+        AnyBoard any_board;
+    };
+    const BoardOps *ops;  /* functions of the size the game plays on */
+    Piece current_piece;
+    uint64_t seed;  /* seed the game was started with */
+    Rng rng;
+    int randomizer;  /* one of RANDOMIZERS */
+    uint8_t bag[NPIECES];  /* shapes left in the current bag are bag[0, bag_left) */
+    int bag_left;
+    int score;
+    int level;
+    int total_rows;  /* total number of full rows made in the game */
+    int pieces_spawned;
+    uint32_t events;  /* GAME_EVENTS raised since the front end last looked */
+    bool over;
+} Game;
+
+
+/* all orientations of every shape, rotating clockwise goes to the next one */
+extern const Rotation PIECE_ROTATIONS[NPIECES][NROTATIONS];
+
+
+bool game_drop(Game *, int, int);
+void game_init(Game *, uint64_t, int);
+void game_init_size(Game *, const BoardOps *, uint64_t, int);
+void game_land(Game *);
+bool game_place(Game *, int, int, int);
+uint32_t level_timer_ticks(int);
+bool piece_collided(Game *, Piece *);
+void piece_move(Game *, Piece *);
+int piece_next_shape(Game *);
+bool piece_rotate_anticlock(Game *, Piece *);
+bool piece_rotate_clock(Game *, Piece *);
+Piece *piece_spawn(Game *);
+void playfield_add_piece(Game *, Piece *);
+int playfield_drop_full_rows(Game *);
+void playfield_cells(const Game *, uint8_t [][BOARD_WIDTH]);
+void playfield_print(const Game *);
+bool update_level(int, int);
+int update_score(int, int);
+
+
+static inline const Rotation *piece_rotation(const Piece *p) {
+    return &PIECE_ROTATIONS[p->shape - 1][p->rotation];
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "engine.h"
+#include "input.h"
+
+
+static void apply_event(Input *, Game *, InputEvent *);
+static void drop(Game *);
+static bool shift(Game *, int);
+
+
+void input_init(Input *in, uint32_t das, uint32_t arr) {
+    memset(in, 0, sizeof(Input));
+    in->das = das;
+    in->arr = arr;
+}
+
+
+/* queue a key event, returns false if the queue is full and the event was
+ * dropped */
+bool input_push(Input *in, int action, bool pressed, uint64_t time) {
+    if (in->tail - in->head == INPUT_QUEUE_LENGTH) {
+        return false;
+    }
+    InputEvent *e = &in->queue[in->tail % INPUT_QUEUE_LENGTH];
+    e->time = time;
+    e->action = action;
+    e->pressed = pressed;
+    in->tail++;
+    return true;
+}
+
+
+/* play the events and auto shifts that happened before the given time, in
+ * the order they happened, so that neither depends on when frames or logic
+ * steps are run; a piece landing is locked right away so that what follows
+ * goes to the next piece */
+void input_replay(Input *in, Game *g, uint64_t until) {
+    while (!g->over) {
+        InputEvent *e = NULL;
+        uint64_t t = until;
+        int what = -1;
+
+        if (in->head != in->tail && in->queue[in->head % INPUT_QUEUE_LENGTH].time < t) {
+            e = &in->queue[in->head % INPUT_QUEUE_LENGTH];
+            t = e->time;
+            what = 0;
+        }
+        if (in->shift != 0 && in->shift_next < t) {
+            t = in->shift_next;
+            what = 1;
+        }
+        if (in->held[ACTION_DOWN] && in->drop_next < t) {
+            t = in->drop_next;
+            what = 2;
+        }
+
+        if (what == 0) {
+            apply_event(in, g, e);
+            in->head++;
+        }
+        else if (what == 1) {
+            if (in->arr == 0) {
+                while (shift(g, in->shift)) {
+                }
+                /* keep the piece against the wall from the next step on */
+                in->shift_next = until;
+            }
+            else {
+                shift(g, in->shift);
+                in->shift_next += in->arr;
+            }
+        }
+        else if (what == 2) {
+            drop(g);
+            in->drop_next += INPUT_SOFT_DROP;
+        }
+        else {
+            break;
+        }
+
+        if (g->current_piece.landed) {
+            game_land(g);
+        }
+    }
+}
+
+
+static void apply_event(Input *in, Game *g, InputEvent *e) {
+    Piece *p = &g->current_piece;
+    int direction = e->action == ACTION_LEFT ? -1 : 1;
+
+    in->held[e->action] = e->pressed;
+    switch (e->action) {
+        case ACTION_LEFT:
+        case ACTION_RIGHT:
+            if (e->pressed) {
+                /* the last direction pressed wins */
+                shift(g, direction);
+                in->shift = direction;
+                in->shift_next = e->time + in->das;
+            }
+            else if (in->shift == direction) {
+                /* fall back on the other direction if it is still held */
+                int other = direction < 0 ? ACTION_RIGHT : ACTION_LEFT;
+                in->shift = in->held[other] ? -direction : 0;
+                in->shift_next = e->time + in->das;
+            }
+            break;
+        case ACTION_DOWN:
+            if (e->pressed) {
+                drop(g);
+                in->drop_next = e->time + INPUT_SOFT_DROP;
+            }
+            break;
+        case ACTION_ROTATE_ANTICLOCK:
+            if (e->pressed && piece_rotate_anticlock(g, p)) {
+                piece_rotate_clock(g, p);
+            }
+            break;
+        case ACTION_ROTATE_CLOCK:
+            if (e->pressed && piece_rotate_clock(g, p)) {
+                piece_rotate_anticlock(g, p);
+            }
+            break;
+    }
+}
+
+
+/* move the piece one row down, it lands if it cannot */
+static void drop(Game *g) {
+    Piece *p = &g->current_piece;
+    p->velx = 0;
+    p->vely = PIECE_VELOCITY;
+    piece_move(g, p);
+    p->vely = 0;
+}
+
+
+/* move the piece one column, returns false if it was blocked */
+static bool shift(Game *g, int direction) {
+    Piece *p = &g->current_piece;
+    int posx = p->posx;
+    p->velx = direction * PIECE_VELOCITY;
+    p->vely = 0;
+    piece_move(g, p);
+    p->velx = 0;
+    return p->posx != posx;
+}
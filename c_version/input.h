@@ -0,0 +1,53 @@
+#ifndef __input_h__
+#define __input_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "engine.h"
+
+
+#define INPUT_QUEUE_LENGTH 256  /* must be a power of two */
+#define INPUT_DEFAULT_DAS 167000  /* all times in microseconds */
+#define INPUT_DEFAULT_ARR 33000
+#define INPUT_SOFT_DROP 100000  /* delay between two steps of a held soft drop */
+
+
+/* what the player can ask for, independent of the keys bound to it */
+enum ACTIONS {
+    ACTION_LEFT,
+    ACTION_RIGHT,
+    ACTION_DOWN,
+    ACTION_ROTATE_ANTICLOCK,
+    ACTION_ROTATE_CLOCK,
+    NACTIONS
+};
+
+
+typedef struct input_event {
+    uint64_t time;  /* when the key changed state */
+    uint8_t action;
+    bool pressed;
+} InputEvent;
+
+/* key events waiting to be replayed on the logic steps, and the state of
+ * held keys: a held left or right moves the piece once, then again after
+ * the delayed auto shift (das), then every auto repeat rate (arr) */
+typedef struct input {
+    InputEvent queue[INPUT_QUEUE_LENGTH];
+    uint32_t head;  /* next event to replay */
+    uint32_t tail;  /* where the next event is stored */
+    uint32_t das;
+    uint32_t arr;  /* 0 moves the piece to the wall right away */
+    bool held[NACTIONS];
+    int shift;  /* direction of the auto shift, -1, 0 or 1 */
+    uint64_t shift_next;  /* when the auto shift moves the piece again */
+    uint64_t drop_next;  /* when a held soft drop moves the piece again */
+} Input;
+
+
+void input_init(Input *, uint32_t, uint32_t);
+bool input_push(Input *, int, bool, uint64_t);
+void input_replay(Input *, Game *, uint64_t);
+
+#endif
@@ -0,0 +1,298 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "leaderboard.h"
+#include "scores.h"
+
+
+static bool before(const Leaderboard *, uint32_t, uint32_t);
+static bool grow(Leaderboard *, uint64_t);
+static uint32_t insert(Leaderboard *, uint32_t, uint32_t);
+static bool map(Leaderboard *, uint64_t);
+static uint32_t priority(uint32_t);
+static void resize(Leaderboard *, uint32_t);
+static uint32_t rotate_left(Leaderboard *, uint32_t);
+static uint32_t rotate_right(Leaderboard *, uint32_t);
+static uint32_t size(const Leaderboard *, uint32_t);
+
+
+/* a clean close marks the index as consistent on disk */
+void leaderboard_close(Leaderboard *lb) {
+    if (lb == NULL) {
+        return;
+    }
+    if (lb->map != NULL) {
+        msync(lb->map, lb->size, MS_SYNC);
+        lb->header->open = 0;
+        msync(lb->map, LEADERBOARD_HEADER_SIZE, MS_SYNC);
+        munmap(lb->map, lb->size);
+    }
+    if (lb->fd >= 0) {
+        close(lb->fd);
+    }
+    free(lb);
+}
+
+
+/* open the index of a score store, it is created or rebuilt if it is
+ * missing, was not closed cleanly or is ahead of the store, and catches up
+ * with records appended without it */
+Leaderboard *leaderboard_open(const Scores *s, const char *path) {
+    struct stat st;
+    Leaderboard *lb = calloc(1, sizeof(Leaderboard));
+    check_mem(lb);
+
+    lb->fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    check(lb->fd >= 0, "Failed to open %s", path);
+    check(fstat(lb->fd, &st) == 0, "Failed to get the size of %s", path);
+    if ((uint64_t) st.st_size < LEADERBOARD_HEADER_SIZE) {
+        check(ftruncate(lb->fd, LEADERBOARD_HEADER_SIZE) == 0, "Failed to size %s", path);
+        st.st_size = LEADERBOARD_HEADER_SIZE;
+    }
+    check(map(lb, st.st_size), "Failed to map %s", path);
+
+    LeaderboardHeader *h = lb->header;
+    if (
+        memcmp(h->magic, LEADERBOARD_MAGIC, sizeof(h->magic)) != 0
+        || h->version != LEADERBOARD_VERSION
+        || h->open
+        || h->count > s->header.count
+        || h->sequence > s->header.sequence
+        || LEADERBOARD_HEADER_SIZE + h->count * sizeof(LeaderboardNode) > lb->size
+    ) {
+        memset(h, 0, sizeof(LeaderboardHeader));
+        memcpy(h->magic, LEADERBOARD_MAGIC, sizeof(h->magic));
+        h->version = LEADERBOARD_VERSION;
+        h->root = LEADERBOARD_NIL;
+    }
+    h->open = 1;
+    check(msync(lb->map, LEADERBOARD_HEADER_SIZE, MS_SYNC) == 0, "Failed to sync %s", path);
+    check(leaderboard_update(lb, s), "Failed to index %s", path);
+    return lb;
+
+    error:
+        leaderboard_close(lb);
+        return NULL;
+}
+
+
+/* rank of a record of the store, 0 is the best score */
+uint64_t leaderboard_position(const Leaderboard *lb, uint64_t record) {
+    uint32_t n = lb->header->root;
+    uint64_t rank = 0;
+
+    while (n != LEADERBOARD_NIL && n != record) {
+        if (before(lb, record, n)) {
+            n = lb->nodes[n].left;
+        }
+        else {
+            rank += size(lb, lb->nodes[n].left) + 1;
+            n = lb->nodes[n].right;
+        }
+    }
+    return n == LEADERBOARD_NIL ? rank : rank + size(lb, lb->nodes[n].left);
+}
+
+
+/* fill records with the store indices of ranks first to first + n - 1,
+ * returns how many there are: the walk goes down to the first one then
+ * on in order, so this costs O(log(count) + n) */
+int leaderboard_range(const Leaderboard *lb, uint64_t first, int n, uint64_t *records) {
+    uint32_t stack[LEADERBOARD_MAX_DEPTH];
+    int depth = 0;
+    uint32_t node = lb->header->root;
+    int found = 0;
+
+    /* the stack holds the nodes still to visit, each above its right subtree */
+    while (node != LEADERBOARD_NIL && depth < LEADERBOARD_MAX_DEPTH) {
+        uint32_t left = size(lb, lb->nodes[node].left);
+        if (first < left) {
+            stack[depth++] = node;
+            node = lb->nodes[node].left;
+        }
+        else if (first == left) {
+            stack[depth++] = node;
+            break;
+        }
+        else {
+            first -= left + 1;
+            node = lb->nodes[node].right;
+        }
+    }
+    while (found < n && depth > 0) {
+        node = stack[--depth];
+        records[found++] = node;
+        for (node = lb->nodes[node].right; node != LEADERBOARD_NIL; node = lb->nodes[node].left) {
+            check(depth < LEADERBOARD_MAX_DEPTH, "Leaderboard too deep");
+            stack[depth++] = node;
+        }
+    }
+    return found;
+
+    error:
+        return found;
+}
+
+
+/* rank a score would get, that is the number of better ones */
+uint64_t leaderboard_rank(const Leaderboard *lb, uint32_t score) {
+    uint32_t n = lb->header->root;
+    uint64_t rank = 0;
+
+    while (n != LEADERBOARD_NIL) {
+        if (lb->nodes[n].score > score) {
+            rank += size(lb, lb->nodes[n].left) + 1;
+            n = lb->nodes[n].right;
+        }
+        else {
+            n = lb->nodes[n].left;
+        }
+    }
+    return rank;
+}
+
+
+/* index the records appended to the store since the last update */
+bool leaderboard_update(Leaderboard *lb, const Scores *s) {
+    uint64_t count = s->header.count;
+
+    check(count < LEADERBOARD_NIL, "Too many scores for the leaderboard");
+    check(grow(lb, count), "Failed to grow leaderboard");
+    LeaderboardHeader *h = lb->header;
+    for (uint64_t i = h->count; i < count; i++) {
+        LeaderboardNode *node = &lb->nodes[i];
+        node->score = scores_get(s, i)->score;
+        node->left = LEADERBOARD_NIL;
+        node->right = LEADERBOARD_NIL;
+        node->size = 1;
+        h->root = insert(lb, h->root, i);
+    }
+    h->count = count;
+    h->sequence = s->header.sequence;
+    return true;
+
+    error:
+        return false;
+}
+
+
+/* better score first, the earlier record on a tie */
+static bool before(const Leaderboard *lb, uint32_t a, uint32_t b) {
+    uint32_t sa = lb->nodes[a].score;
+    uint32_t sb = lb->nodes[b].score;
+    return sa > sb || (sa == sb && a < b);
+}
+
+
+/* make room for count nodes, doubling the file as needed; the old mapping
+ * stays in place if the new one cannot be made */
+static bool grow(Leaderboard *lb, uint64_t count) {
+    uint64_t capacity = (lb->size - LEADERBOARD_HEADER_SIZE) / sizeof(LeaderboardNode);
+    if (count <= capacity) {
+        return true;
+    }
+    if (capacity < SCORES_MIN_CAPACITY) {
+        capacity = SCORES_MIN_CAPACITY;
+    }
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    uint64_t size = LEADERBOARD_HEADER_SIZE + capacity * sizeof(LeaderboardNode);
+    uint8_t *old = lb->map;
+    uint64_t old_size = lb->size;
+    check(ftruncate(lb->fd, size) == 0, "Failed to grow leaderboard file");
+    check(map(lb, size), "Failed to map grown leaderboard file");
+    munmap(old, old_size);
+    return true;
+
+    error:
+        return false;
+}
+
+
+/* insert node i in the subtree at root and return its new root: i goes
+ * down as in a search tree, then up while its priority beats its parent's */
+static uint32_t insert(Leaderboard *lb, uint32_t root, uint32_t i) {
+    if (root == LEADERBOARD_NIL) {
+        return i;
+    }
+    LeaderboardNode *n = &lb->nodes[root];
+    n->size++;
+    if (before(lb, i, root)) {
+        n->left = insert(lb, n->left, i);
+        if (priority(n->left) > priority(root)) {
+            return rotate_right(lb, root);
+        }
+    }
+    else {
+        n->right = insert(lb, n->right, i);
+        if (priority(n->right) > priority(root)) {
+            return rotate_left(lb, root);
+        }
+    }
+    return root;
+}
+
+
+static bool map(Leaderboard *lb, uint64_t size) {
+    void *m = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, lb->fd, 0);
+    check(m != MAP_FAILED, "Failed to map leaderboard file");
+    lb->map = m;
+    lb->size = size;
+    lb->header = m;
+    lb->nodes = (LeaderboardNode *) (lb->map + LEADERBOARD_HEADER_SIZE);
+    return true;
+
+    error:
+        return false;
+}
+
+
+/* treap priorities are a hash of the record so that they need no storage
+ * and the tree does not depend on the order records are indexed in */
+static uint32_t priority(uint32_t i) {
+    i ^= i >> 16;
+    i *= 0x7FEB352D;
+    i ^= i >> 15;
+    i *= 0x846CA68B;
+    i ^= i >> 16;
+    return i;
+}
+
+
+static void resize(Leaderboard *lb, uint32_t n) {
+    LeaderboardNode *node = &lb->nodes[n];
+    node->size = 1 + size(lb, node->left) + size(lb, node->right);
+}
+
+
+static uint32_t rotate_left(Leaderboard *lb, uint32_t root) {
+    uint32_t right = lb->nodes[root].right;
+    lb->nodes[root].right = lb->nodes[right].left;
+    lb->nodes[right].left = root;
+    resize(lb, root);
+    resize(lb, right);
+    return right;
+}
+
+
+static uint32_t rotate_right(Leaderboard *lb, uint32_t root) {
+    uint32_t left = lb->nodes[root].left;
+    lb->nodes[root].left = lb->nodes[left].right;
+    lb->nodes[left].right = root;
+    resize(lb, root);
+    resize(lb, left);
+    return left;
+}
+
+
+static uint32_t size(const Leaderboard *lb, uint32_t n) {
+    return n == LEADERBOARD_NIL ? 0 : lb->nodes[n].size;
+}
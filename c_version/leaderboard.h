@@ -0,0 +1,55 @@
+#ifndef __leaderboard_h__
+#define __leaderboard_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "scores.h"
+
+
+#define LEADERBOARD_MAGIC "TLBD"
+#define LEADERBOARD_VERSION 1
+#define LEADERBOARD_HEADER_SIZE 64
+#define LEADERBOARD_NIL UINT32_MAX
+#define LEADERBOARD_MAX_DEPTH 256  /* a treap this deep has odds of about 0 */
+
+
+/* the node of record i of the score store is node i of the index, nodes
+ * are ordered by score, best first, then by record */
+typedef struct leaderboard_node {
+    uint32_t score;
+    uint32_t left;  /* LEADERBOARD_NIL if none */
+    uint32_t right;
+    uint32_t size;  /* nodes in the subtree */
+} LeaderboardNode;
+
+typedef struct leaderboard_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t root;
+    uint32_t open;  /* set while the index is in use, if a crash leaves it
+                     * set the index is rebuilt from the store */
+    uint64_t count;  /* records of the store in the index */
+    uint64_t sequence;  /* of the store commit the index is up to date with */
+} LeaderboardHeader;
+
+/* an order statistic tree over the records of a score store, kept as a
+ * treap in a file next to it: submitting, ranking and selecting by rank
+ * all take logarithmic time */
+typedef struct leaderboard {
+    int fd;
+    uint8_t *map;
+    uint64_t size;
+    LeaderboardHeader *header;  /* in the mapping */
+    LeaderboardNode *nodes;
+} Leaderboard;
+
+
+void leaderboard_close(Leaderboard *);
+Leaderboard *leaderboard_open(const Scores *, const char *);
+uint64_t leaderboard_position(const Leaderboard *, uint64_t);
+int leaderboard_range(const Leaderboard *, uint64_t, int, uint64_t *);
+uint64_t leaderboard_rank(const Leaderboard *, uint32_t);
+bool leaderboard_update(Leaderboard *, const Scores *);
+
+#endif
@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "engine.h"
+#include "input.h"
+#include "logic.h"
+
+
+void logic_init(Logic *l, uint64_t start) {
+    memset(l, 0, sizeof(Logic));
+    l->start = start;
+}
+
+
+/* move the clock forward without simulating, for time the game could not
+ * keep up with */
+void logic_skip(Logic *l, uint64_t time) {
+    l->start += time;
+}
+
+
+/* replay the input due by the end of the step, then let the piece fall if
+ * it is its time and lock it once it landed */
+void logic_step(Logic *l, Game *g, Input *in) {
+    Piece *p = &g->current_piece;
+
+    l->steps++;
+    input_replay(in, g, logic_time(l));
+
+    /* descend piece on playfield, only if it is not already moving down */
+    l->gravity++;
+    if (l->gravity * 1000 / LOGIC_HZ > level_timer_ticks(g->level)) {
+        l->gravity = 0;
+        if (!in->held[ACTION_DOWN] && !g->over) {
+            p->vely = PIECE_VELOCITY;
+            piece_move(g, p);
+            p->vely = 0;
+        }
+    }
+
+    if (p->landed) {
+        game_land(g);
+        l->gravity = 0;
+    }
+}
+
+
+/* end of the last step run */
+uint64_t logic_time(const Logic *l) {
+    return l->start + l->steps * 1000000 / LOGIC_HZ;
+}
@@ -0,0 +1,27 @@
+#ifndef __logic_h__
+#define __logic_h__
+
+#include <stdint.h>
+
+#include "engine.h"
+#include "input.h"
+
+
+#define LOGIC_HZ 240  /* game logic steps per second */
+
+
+/* the fixed step clock of a game: step n ends at start + n / LOGIC_HZ
+ * seconds, on the same clock as input event times */
+typedef struct logic {
+    uint64_t start;  /* time of step 0, in microseconds */
+    uint64_t steps;  /* steps run so far */
+    int gravity;  /* steps since the piece last fell */
+} Logic;
+
+
+void logic_init(Logic *, uint64_t);
+void logic_skip(Logic *, uint64_t);
+void logic_step(Logic *, Game *, Input *);
+uint64_t logic_time(const Logic *);
+
+#endif
@@ -0,0 +1,344 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PLACEMENT_X86
+#endif
+
+#include "board.h"
+#include "engine.h"
+#include "placement.h"
+
+
+/* one lane per horizontal position of a piece, a piece is at least one column
+ * wide so it never has more than BOARD_WIDTH positions */
+#define PLACEMENT_LANES BOARD_WIDTH
+
+
+/* drop every lane of one orientation from row posy, masks[r][l] is row r of
+ * the piece shifted to lane l (0 for unused lanes), writes the landing row
+ * (-1 if the lane collides at posy) and the number of full rows per lane */
+typedef void (*ScanKernel)(
+    const Board *,
+    const uint16_t (*)[PLACEMENT_LANES],
+    int,
+    int,
+    int16_t *,
+    int16_t *
+);
+
+
+static bool placement_greedy_any(Game *);
+static void placement_resolve();
+static void scan_scalar(
+    const Board *, const uint16_t (*)[PLACEMENT_LANES], int, int, int16_t *, int16_t *
+);
+#ifdef PLACEMENT_X86
+static void scan_avx2(
+    const Board *, const uint16_t (*)[PLACEMENT_LANES], int, int, int16_t *, int16_t *
+);
+static void scan_sse2(
+    const Board *, const uint16_t (*)[PLACEMENT_LANES], int, int, int16_t *, int16_t *
+);
+#endif
+
+
+static pthread_once_t placement_once = PTHREAD_ONCE_INIT;
+static ScanKernel scan_kernel = scan_scalar;
+static const char *scan_kernel_name = "scalar";
+
+
+/* drop the piece where it clears the most rows, then where it ends up the
+ * lowest, return false if it fits nowhere */
+bool placement_greedy(Game *g) {
+    Placements placements;
+    int best = -1, best_rotation = 0, best_posx = 0;
+
+    if (g->ops != &board_ops) {
+        return placement_greedy_any(g);
+    }
+    placement_scan(&g->board, g->current_piece.shape, g->current_piece.posy, &placements);
+    for (int r = 0; r < NROTATIONS; r++) {
+        const Rotation *rot = &PIECE_ROTATIONS[g->current_piece.shape - 1][r];
+        for (int c = 0; c < PLACEMENT_COLUMNS; c++) {
+            if (placements.row[r][c] < 0) {
+                continue;
+            }
+            int value = placements.clears[r][c] * 100 + placements.row[r][c] + rot->maxy;
+            if (value > best) {
+                best = value;
+                best_rotation = r;
+                best_posx = c + PLACEMENT_MIN_X;
+            }
+        }
+    }
+    return best >= 0 && game_drop(g, best_rotation, best_posx);
+}
+
+
+const char *placement_kernel_name() {
+    pthread_once(&placement_once, placement_resolve);
+    return scan_kernel_name;
+}
+
+
+/* the same choice on a board of any size, one column at a time through the
+ * kernels of that size since the lanes of the scan are as wide as the game
+ * board */
+static bool placement_greedy_any(Game *g) {
+    const BoardOps *ops = g->ops;
+    const Piece *p = &g->current_piece;
+    int best = -1, best_rotation = 0, best_posx = 0;
+
+    for (int r = 0; r < NROTATIONS; r++) {
+        const Rotation *rot = &PIECE_ROTATIONS[p->shape - 1][r];
+        for (int x = PLACEMENT_MIN_X; x < ops->width; x++) {
+            int y = p->posy;
+            if (ops->collided(&g->any_board, rot->rows, x, y)) {
+                continue;
+            }
+            while (!ops->collided(&g->any_board, rot->rows, x, y + 1)) {
+                y++;
+            }
+            int value = ops->clears(&g->any_board, rot->rows, x, y) * 100 + y + rot->maxy;
+            if (value > best) {
+                best = value;
+                best_rotation = r;
+                best_posx = x;
+            }
+        }
+    }
+    return best >= 0 && game_drop(g, best_rotation, best_posx);
+}
+
+
+/* pick the widest kernel the CPU supports, TETRIS_PLACEMENT_KERNEL can force
+ * a narrower one (e.g. to compare results between kernels) */
+static void placement_resolve() {
+    const char *forced = getenv("TETRIS_PLACEMENT_KERNEL");
+    if (forced != NULL && strcmp(forced, "scalar") == 0) {
+        return;
+    }
+#ifdef PLACEMENT_X86
+    __builtin_cpu_init();
+    if (
+        __builtin_cpu_supports("avx2") &&
+        (forced == NULL || strcmp(forced, "avx2") == 0)
+    ) {
+        scan_kernel = scan_avx2;
+        scan_kernel_name = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        scan_kernel = scan_sse2;
+        scan_kernel_name = "sse2";
+    }
+#endif
+}
+
+
+/* find where a piece of the given shape lands for each orientation and each
+ * horizontal position when dropped straight down from row posy */
+void placement_scan(const Board *b, int shape, int posy, Placements *out) {
+    uint16_t masks[BOARD_PIECE_ROWS][PLACEMENT_LANES];
+    int16_t row[PLACEMENT_LANES];
+    int16_t clears[PLACEMENT_LANES];
+
+    pthread_once(&placement_once, placement_resolve);
+    memset(out->row, -1, sizeof(out->row));
+    memset(out->clears, 0, sizeof(out->clears));
+    if (posy < 0 || posy > BOARD_HEIGHT) {
+        return;
+    }
+
+    for (int r = 0; r < NROTATIONS; r++) {
+        const Rotation *rot = &PIECE_ROTATIONS[shape - 1][r];
+        int nlanes = BOARD_WIDTH - (rot->maxx - rot->minx);
+        for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+            uint16_t base = rot->rows[i] >> rot->minx;
+            for (int l = 0; l < PLACEMENT_LANES; l++) {
+                masks[i][l] = l < nlanes ? base << l : 0;
+            }
+        }
+        scan_kernel(b, (const uint16_t (*)[PLACEMENT_LANES]) masks, nlanes, posy, row, clears);
+        /* lane l has its leftmost cell in column l */
+        for (int l = 0; l < nlanes; l++) {
+            int column = l - rot->minx - PLACEMENT_MIN_X;
+            out->row[r][column] = row[l];
+            out->clears[r][column] = clears[l];
+        }
+    }
+}
+
+
+static void scan_scalar(
+    const Board *b,
+    const uint16_t (*masks)[PLACEMENT_LANES],
+    int nlanes,
+    int posy,
+    int16_t *row,
+    int16_t *clears
+) {
+    for (int l = 0; l < nlanes; l++) {
+        uint16_t hit = 0;
+        int y = posy;
+        for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+            hit |= masks[i][l] & b->rows[y + i];
+        }
+        row[l] = -1;
+        clears[l] = 0;
+        if (hit != 0) {
+            continue;
+        }
+        for (;;) {
+            for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+                hit |= masks[i][l] & b->rows[y + 1 + i];
+            }
+            if (hit != 0) {
+                break;
+            }
+            y++;
+        }
+        row[l] = y;
+        for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+            if (masks[i][l] != 0 && (masks[i][l] | b->rows[y + i]) == BOARD_ROW_FULL) {
+                clears[l]++;
+            }
+        }
+    }
+}
+
+
+#ifdef PLACEMENT_X86
+
+__attribute__((target("avx2")))
+static void scan_avx2(
+    const Board *b,
+    const uint16_t (*masks)[PLACEMENT_LANES],
+    int nlanes,
+    int posy,
+    int16_t *row,
+    int16_t *clears
+) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(-1);
+    __m256i p[BOARD_PIECE_ROWS];
+    __m256i filled[BOARD_PIECE_ROWS];  /* lanes where piece row i is not empty */
+    __m256i hit = zero;
+
+    for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+        p[i] = _mm256_loadu_si256((const __m256i *) masks[i]);
+        filled[i] = _mm256_andnot_si256(_mm256_cmpeq_epi16(p[i], zero), ones);
+        hit = _mm256_or_si256(hit, _mm256_and_si256(p[i], _mm256_set1_epi16(b->rows[posy + i])));
+    }
+    /* lanes past nlanes and lanes blocked at the start are done already */
+    __m256i lane = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m256i done = _mm256_cmpgt_epi16(lane, _mm256_set1_epi16(nlanes - 1));
+    done = _mm256_or_si256(done, _mm256_andnot_si256(_mm256_cmpeq_epi16(hit, zero), ones));
+    __m256i landing = _mm256_set1_epi16(-1);
+    __m256i full = zero;
+
+    for (int y = posy; _mm256_movemask_epi8(done) != -1; y++) {
+        hit = zero;
+        for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+            hit = _mm256_or_si256(hit, _mm256_and_si256(p[i], _mm256_set1_epi16(b->rows[y + 1 + i])));
+        }
+        __m256i land = _mm256_andnot_si256(
+            _mm256_or_si256(done, _mm256_cmpeq_epi16(hit, zero)),
+            ones
+        );
+        if (_mm256_testz_si256(land, land)) {
+            continue;
+        }
+        __m256i count = zero;
+        for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+            __m256i merged = _mm256_or_si256(p[i], _mm256_set1_epi16(b->rows[y + i]));
+            __m256i is_full = _mm256_and_si256(_mm256_cmpeq_epi16(merged, ones), filled[i]);
+            count = _mm256_sub_epi16(count, is_full);
+        }
+        landing = _mm256_blendv_epi8(landing, _mm256_set1_epi16(y), land);
+        full = _mm256_blendv_epi8(full, count, land);
+        done = _mm256_or_si256(done, land);
+    }
+    _mm256_storeu_si256((__m256i *) row, landing);
+    _mm256_storeu_si256((__m256i *) clears, full);
+}
+
+
+static inline __m128i blend_sse2(__m128i a, __m128i b, __m128i mask) {
+    return _mm_or_si128(_mm_andnot_si128(mask, a), _mm_and_si128(mask, b));
+}
+
+
+/* same as scan_avx2 with the 16 lanes split over two registers */
+__attribute__((target("sse2")))
+static void scan_sse2(
+    const Board *b,
+    const uint16_t (*masks)[PLACEMENT_LANES],
+    int nlanes,
+    int posy,
+    int16_t *row,
+    int16_t *clears
+) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(-1);
+    __m128i p[BOARD_PIECE_ROWS][2];
+    __m128i filled[BOARD_PIECE_ROWS][2];
+    __m128i hit[2] = {zero, zero};
+    __m128i done[2];
+    __m128i landing[2];
+    __m128i full[2];
+    __m128i last = _mm_set1_epi16(nlanes - 1);
+
+    done[0] = _mm_cmpgt_epi16(_mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7), last);
+    done[1] = _mm_cmpgt_epi16(_mm_setr_epi16(8, 9, 10, 11, 12, 13, 14, 15), last);
+    for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+        __m128i board_row = _mm_set1_epi16(b->rows[posy + i]);
+        for (int h = 0; h < 2; h++) {
+            p[i][h] = _mm_loadu_si128((const __m128i *) &masks[i][h * 8]);
+            filled[i][h] = _mm_andnot_si128(_mm_cmpeq_epi16(p[i][h], zero), ones);
+            hit[h] = _mm_or_si128(hit[h], _mm_and_si128(p[i][h], board_row));
+        }
+    }
+    for (int h = 0; h < 2; h++) {
+        done[h] = _mm_or_si128(done[h], _mm_andnot_si128(_mm_cmpeq_epi16(hit[h], zero), ones));
+        landing[h] = ones;
+        full[h] = zero;
+    }
+
+    for (int y = posy; _mm_movemask_epi8(_mm_and_si128(done[0], done[1])) != 0xFFFF; y++) {
+        __m128i land[2];
+        hit[0] = hit[1] = zero;
+        for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+            __m128i board_row = _mm_set1_epi16(b->rows[y + 1 + i]);
+            hit[0] = _mm_or_si128(hit[0], _mm_and_si128(p[i][0], board_row));
+            hit[1] = _mm_or_si128(hit[1], _mm_and_si128(p[i][1], board_row));
+        }
+        for (int h = 0; h < 2; h++) {
+            land[h] = _mm_andnot_si128(_mm_or_si128(done[h], _mm_cmpeq_epi16(hit[h], zero)), ones);
+        }
+        if (_mm_movemask_epi8(_mm_or_si128(land[0], land[1])) == 0) {
+            continue;
+        }
+        for (int h = 0; h < 2; h++) {
+            __m128i count = zero;
+            for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+                __m128i merged = _mm_or_si128(p[i][h], _mm_set1_epi16(b->rows[y + i]));
+                __m128i is_full = _mm_and_si128(_mm_cmpeq_epi16(merged, ones), filled[i][h]);
+                count = _mm_sub_epi16(count, is_full);
+            }
+            landing[h] = blend_sse2(landing[h], _mm_set1_epi16(y), land[h]);
+            full[h] = blend_sse2(full[h], count, land[h]);
+            done[h] = _mm_or_si128(done[h], land[h]);
+        }
+    }
+    for (int h = 0; h < 2; h++) {
+        _mm_storeu_si128((__m128i *) &row[h * 8], landing[h]);
+        _mm_storeu_si128((__m128i *) &clears[h * 8], full[h]);
+    }
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef __placement_h__
+#define __placement_h__
+
+#include <stdint.h>
+
+#include "board.h"
+#include "engine.h"
+
+
+/* a piece matrix can stick out of the playfield by up to 3 empty columns on
+ * the left, so posx goes from -3 to BOARD_WIDTH - 1 */
+#define PLACEMENT_MIN_X (1 - PIECE_MATRIX_WIDTH)
+#define PLACEMENT_COLUMNS (BOARD_WIDTH - PLACEMENT_MIN_X)
+
+
+/* where a piece lands when dropped straight down from a given row, for every
+ * orientation and horizontal position (index posx - PLACEMENT_MIN_X) */
+typedef struct placements {
+    int8_t row[NROTATIONS][PLACEMENT_COLUMNS];  /* landing posy, -1 if impossible */
+    int8_t clears[NROTATIONS][PLACEMENT_COLUMNS];  /* rows completed by the piece */
+} Placements;
+
+
+bool placement_greedy(Game *);
+const char *placement_kernel_name();
+void placement_scan(const Board *, int, int, Placements *);
+
+#endif
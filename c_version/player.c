@@ -0,0 +1,107 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "debug.h"
+#include "replay.h"
+
+
+bool check_file(const char *, uint64_t *);
+uint8_t *read_file(const char *, size_t *);
+
+
+/* replay one game and print how it compares to what was recorded */
+bool check_file(const char *path, uint64_t *events) {
+    ReplayResult recorded, replayed;
+    size_t size;
+    uint8_t *data = read_file(path, &size);
+    check(data != NULL, "Failed to read %s", path);
+    check(replay_play(data, size, &recorded, &replayed), "Failed to replay %s", path);
+    free(data);
+
+    bool ok = replay_matches(&recorded, &replayed);
+    printf(
+        "%s: %s, score %u, rows %u, level %u, %u pieces, %u events, %u steps\n",
+        path,
+        ok ? "ok" : "MISMATCH",
+        replayed.score,
+        replayed.lines,
+        replayed.level,
+        replayed.pieces,
+        replayed.events,
+        replayed.steps
+    );
+    if (!ok) {
+        printf(
+            "    recorded score %u, rows %u, level %u, %u pieces, %u events, %u steps\n",
+            recorded.score,
+            recorded.lines,
+            recorded.level,
+            recorded.pieces,
+            recorded.events,
+            recorded.steps
+        );
+    }
+    *events += replayed.events;
+    return ok;
+
+    error:
+        free(data);
+        return false;
+}
+
+
+uint8_t *read_file(const char *path, size_t *size) {
+    uint8_t *data = NULL;
+    FILE *fp = fopen(path, "rb");
+    check(fp != NULL, "Failed to open %s", path);
+    check(fseek(fp, 0, SEEK_END) == 0, "Failed to seek %s", path);
+    long length = ftell(fp);
+    check(length >= 0, "Failed to get the size of %s", path);
+    rewind(fp);
+    data = malloc(length > 0 ? length : 1);
+    check_mem(data);
+    check(fread(data, 1, length, fp) == (size_t) length, "Failed to read %s", path);
+    fclose(fp);
+    *size = length;
+    return data;
+
+    error:
+        if (fp != NULL) {
+            fclose(fp);
+        }
+        free(data);
+        return NULL;
+}
+
+
+int main(int argc, char *argv[]) {
+    struct timespec start, end;
+    uint64_t events = 0;
+    int failed = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s REPLAY...\n", argv[0]);
+        return 2;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 1; i < argc; i++) {
+        if (!check_file(argv[i], &events)) {
+            failed++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(
+        stderr,
+        "%d games, %d failed, %llu events in %.3f s\n",
+        argc - 1,
+        failed,
+        (unsigned long long) events,
+        seconds
+    );
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "debug.h"
+#include "profiler.h"
+
+
+const char *PHASE_NAMES[NPHASES] = {
+    "events", "logic", "render", "text", "present", "delay"
+};
+
+
+static int bucket_index(uint32_t);
+static uint32_t bucket_value(int);
+static int compare_uint32(const void *, const void *);
+static uint64_t now_ns();
+static void series_add(Series *, uint32_t);
+static uint32_t series_percentile(Series *, double);
+static void series_stats(Series *, PhaseStats *);
+static void write_series(FILE *, const char *, Series *);
+
+
+/* note the latency of a sound, as measured by the audio thread */
+void profiler_audio(Profiler *p, uint32_t latency) {
+    series_add(&p->audio, latency);
+}
+
+
+void profiler_audio_stats(Profiler *p, PhaseStats *stats) {
+    series_stats(&p->audio, stats);
+}
+
+
+void profiler_begin_frame(Profiler *p) {
+    memset(p->current, 0, sizeof(p->current));
+    p->mark = now_ns();
+}
+
+
+void profiler_end_frame(Profiler *p) {
+    for (int i = 0; i < NPHASES; i++) {
+        series_add(&p->phases[i], p->current[i]);
+    }
+}
+
+
+void profiler_init(Profiler *p) {
+    memset(p, 0, sizeof(Profiler));
+}
+
+
+/* note a key press that happened age microseconds ago, only the oldest one
+ * still waiting for a present is kept */
+void profiler_input(Profiler *p, uint32_t age) {
+    uint64_t t = now_ns() - (uint64_t) age * 1000;
+    if (p->input == 0 || t < p->input) {
+        p->input = t;
+    }
+}
+
+
+void profiler_latency_stats(Profiler *p, PhaseStats *stats) {
+    series_stats(&p->latency, stats);
+}
+
+
+/* add the time since the previous mark to the given phase of this frame */
+void profiler_mark(Profiler *p, int phase) {
+    uint64_t t = now_ns();
+    p->current[phase] += (t - p->mark) / 1000;
+    p->mark = t;
+}
+
+
+/* call right after the frame is presented, with vsync this is about when it
+ * starts going out to the display */
+void profiler_presented(Profiler *p) {
+    if (p->input != 0) {
+        series_add(&p->latency, (now_ns() - p->input) / 1000);
+        p->input = 0;
+    }
+}
+
+
+/* percentiles of a phase over the last PROFILER_WINDOW frames */
+void profiler_stats(Profiler *p, int phase, PhaseStats *stats) {
+    series_stats(&p->phases[phase], stats);
+}
+
+
+/* one line per phase with statistics over the whole run, then one for the
+ * input latency and one for the audio latency, percentiles come from the
+ * histogram so they are within 1/PROFILER_SUB_BUCKETS of the truth */
+bool profiler_write_csv(Profiler *p, const char *path) {
+    FILE *fp = fopen(path, "w");
+    check(fp != NULL, "Failed to open %s", path);
+    fprintf(fp, "phase,frames,mean_us,p50_us,p99_us,max_us\n");
+    for (int i = 0; i < NPHASES; i++) {
+        write_series(fp, PHASE_NAMES[i], &p->phases[i]);
+    }
+    write_series(fp, "input_to_present", &p->latency);
+    write_series(fp, "trigger_to_output", &p->audio);
+    fclose(fp);
+    return true;
+
+    error:
+        return false;
+}
+
+
+/* values below PROFILER_SUB_BUCKETS get a bucket each, larger ones share
+ * PROFILER_SUB_BUCKETS buckets per power of two */
+static int bucket_index(uint32_t v) {
+    if (v < PROFILER_SUB_BUCKETS) {
+        return v;
+    }
+    int e = 31 - __builtin_clz(v);  /* e >= 4 */
+    int sub = (v >> (e - 4)) & (PROFILER_SUB_BUCKETS - 1);
+    return (e - 3) * PROFILER_SUB_BUCKETS + sub;
+}
+
+
+/* smallest value that falls in bucket b */
+static uint32_t bucket_value(int b) {
+    if (b < PROFILER_SUB_BUCKETS) {
+        return b;
+    }
+    int e = b / PROFILER_SUB_BUCKETS + 3;
+    int sub = b % PROFILER_SUB_BUCKETS;
+    return (uint32_t) (PROFILER_SUB_BUCKETS + sub) << (e - 4);
+}
+
+
+static int compare_uint32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void series_add(Series *s, uint32_t v) {
+    s->window[s->count % PROFILER_WINDOW] = v;
+    s->histogram[bucket_index(v)]++;
+    s->total += v;
+    if (v > s->max) {
+        s->max = v;
+    }
+    s->count++;
+}
+
+
+static uint32_t series_percentile(Series *s, double q) {
+    uint64_t rank = q * s->count;
+    uint64_t seen = 0;
+    for (int b = 0; b < PROFILER_BUCKETS; b++) {
+        seen += s->histogram[b];
+        if (seen > rank) {
+            return bucket_value(b);
+        }
+    }
+    return s->max;
+}
+
+
+static void series_stats(Series *s, PhaseStats *stats) {
+    uint32_t sorted[PROFILER_WINDOW];
+    int n = s->count < PROFILER_WINDOW ? s->count : PROFILER_WINDOW;
+
+    if (n == 0) {
+        stats->p50 = stats->p99 = stats->max = 0;
+        return;
+    }
+    memcpy(sorted, s->window, n * sizeof(uint32_t));
+    qsort(sorted, n, sizeof(uint32_t), compare_uint32);
+    stats->p50 = sorted[(n - 1) / 2];
+    stats->p99 = sorted[(n - 1) * 99 / 100];
+    stats->max = sorted[n - 1];
+}
+
+
+static void write_series(FILE *fp, const char *name, Series *s) {
+    fprintf(
+        fp,
+        "%s,%llu,%.1f,%u,%u,%u\n",
+        name,
+        (unsigned long long) s->count,
+        s->count > 0 ? (double) s->total / s->count : 0.0,
+        series_percentile(s, 0.50),
+        series_percentile(s, 0.99),
+        s->max
+    );
+}
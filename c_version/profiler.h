@@ -0,0 +1,70 @@
+#ifndef __profiler_h__
+#define __profiler_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define PROFILER_WINDOW 256  /* frames kept for the rolling statistics */
+#define PROFILER_SUB_BUCKETS 16  /* histogram buckets per power of two */
+#define PROFILER_BUCKETS (32 * PROFILER_SUB_BUCKETS)
+
+
+/* parts of a frame of the main loop */
+enum PHASES {
+    PHASE_EVENTS,
+    PHASE_LOGIC,
+    PHASE_RENDER,
+    PHASE_TEXT,
+    PHASE_PRESENT,
+    PHASE_DELAY,
+    NPHASES
+};
+
+
+typedef struct phase_stats {
+    uint32_t p50;  /* all times in microseconds */
+    uint32_t p99;
+    uint32_t max;
+} PhaseStats;
+
+/* samples of one measurement: the last PROFILER_WINDOW are kept as is for
+ * the on-screen statistics, and all of them go into a log-linear histogram
+ * for the summary written at exit */
+typedef struct series {
+    uint32_t window[PROFILER_WINDOW];
+    uint64_t count;
+    uint32_t histogram[PROFILER_BUCKETS];
+    uint64_t total;
+    uint32_t max;
+} Series;
+
+/* frame times split by phase, the time from a key press to the end of the
+ * first present that follows it, and the time from a sound trigger until it
+ * is heard */
+typedef struct profiler {
+    uint64_t mark;  /* time of the last profiler_mark, in nanoseconds */
+    uint32_t current[NPHASES];  /* time spent in each phase this frame */
+    Series phases[NPHASES];
+    uint64_t input;  /* oldest key press not presented yet, 0 if none */
+    Series latency;
+    Series audio;
+} Profiler;
+
+
+extern const char *PHASE_NAMES[NPHASES];
+
+
+void profiler_audio(Profiler *, uint32_t);
+void profiler_audio_stats(Profiler *, PhaseStats *);
+void profiler_begin_frame(Profiler *);
+void profiler_end_frame(Profiler *);
+void profiler_init(Profiler *);
+void profiler_input(Profiler *, uint32_t);
+void profiler_latency_stats(Profiler *, PhaseStats *);
+void profiler_mark(Profiler *, int);
+void profiler_presented(Profiler *);
+void profiler_stats(Profiler *, int, PhaseStats *);
+bool profiler_write_csv(Profiler *, const char *);
+
+#endif
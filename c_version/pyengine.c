@@ -0,0 +1,494 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+#include "input.h"
+#include "logic.h"
+
+
+/* Python module over the game logic: tetris_engine.Game runs the same steps
+ * as the C game, and its board and piece can be read through the buffer
+ * protocol without copying (memoryview, numpy.asarray, ...) */
+
+
+#define PY_DEFAULT_DAS (INPUT_DEFAULT_DAS / 1000)  /* milliseconds */
+#define PY_DEFAULT_ARR (INPUT_DEFAULT_ARR / 1000)
+#define PY_PIECE_FIELDS 4  /* shape, rotation, posx and posy lead Piece */
+
+
+/* a game with its own input queue and clock, held in the object itself so
+ * that views of it stay valid as long as the object lives, whatever is done
+ * to the game */
+typedef struct py_game {
+    PyObject_HEAD
+    Game game;
+    Input input;
+    Logic logic;
+} PyGame;
+
+/* read-only buffer over part of a game, the exporter behind the memoryviews
+ * of its board and piece, it keeps the game alive */
+typedef struct py_view {
+    PyObject_HEAD
+    PyGame *owner;
+    void *data;
+    char *format;  /* struct module syntax */
+    Py_ssize_t itemsize;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} PyView;
+
+enum PY_GAME_INTS {PY_GAME_SCORE, PY_GAME_LINES, PY_GAME_LEVEL, PY_GAME_PIECES};
+
+
+static PyView *py_game_cells(PyGame *);
+static PyObject *py_game_clone(PyGame *, PyObject *);
+static void py_game_dealloc(PyGame *);
+static PyObject *py_game_drop(PyGame *, PyObject *);
+static PyObject *py_game_get_cells(PyGame *, void *);
+static PyObject *py_game_get_int(PyGame *, void *);
+static PyObject *py_game_get_over(PyGame *, void *);
+static PyObject *py_game_get_piece(PyGame *, void *);
+static PyObject *py_game_get_rows(PyGame *, void *);
+static PyObject *py_game_get_seed(PyGame *, void *);
+static PyObject *py_game_get_steps(PyGame *, void *);
+static PyObject *py_game_get_time(PyGame *, void *);
+static int py_game_getbuffer(PyGame *, Py_buffer *, int);
+static int py_game_init(PyGame *, PyObject *, PyObject *);
+static PyObject *py_game_key(PyGame *, PyObject *, bool);
+static PyObject *py_game_playfield(PyGame *, PyObject *);
+static PyObject *py_game_press(PyGame *, PyObject *);
+static PyObject *py_game_release(PyGame *, PyObject *);
+static PyObject *py_game_reset(PyGame *, PyObject *, PyObject *);
+static PyObject *py_game_step(PyGame *, PyObject *, PyObject *);
+static bool py_seed(PyObject *, uint64_t *);
+static void py_view_dealloc(PyView *);
+static int py_view_getbuffer(PyView *, Py_buffer *, int);
+static PyObject *py_view_memory(PyView *);
+static PyView *py_view_new(PyGame *, void *, char *, Py_ssize_t, int, Py_ssize_t, Py_ssize_t);
+
+
+static PyMethodDef PY_GAME_METHODS[] = {
+    {"clone", (PyCFunction) py_game_clone, METH_NOARGS,
+        "clone()\n--\n\nIndependent copy of the game, its waiting keys and its clock."},
+    {"__copy__", (PyCFunction) py_game_clone, METH_NOARGS, NULL},
+    {"drop", (PyCFunction) py_game_drop, METH_VARARGS,
+        "drop(rotation, column)\n--\n\n"
+        "Turn the piece, move it to the column and drop it straight down as the bot\n"
+        "does, False if it does not fit there and the game is then left as it was."},
+    {"playfield", (PyCFunction) py_game_playfield, METH_NOARGS,
+        "playfield()\n--\n\nCopy of the cells with the falling piece laid over them, as bytes."},
+    {"press", (PyCFunction) py_game_press, METH_O,
+        "press(action)\n--\n\nPress a key now, it is played by the next step."},
+    {"release", (PyCFunction) py_game_release, METH_O,
+        "release(action)\n--\n\nRelease a key now."},
+    {"reset", (PyCFunction) py_game_reset, METH_VARARGS | METH_KEYWORDS,
+        "reset(seed=None)\n--\n\n"
+        "Start a new game with the same settings, the seed defaults to one drawn from\n"
+        "the current game so that a series of games can be played again."},
+    {"step", (PyCFunction) py_game_step, METH_VARARGS | METH_KEYWORDS,
+        "step(n=1)\n--\n\n"
+        "Run n logic steps of 1 / LOGIC_HZ second, fewer if the game ends, and return\n"
+        "the EVENT_* flags raised meanwhile."},
+    {NULL}
+};
+
+static PyGetSetDef PY_GAME_GETSET[] = {
+    {"cells", (getter) py_game_get_cells, NULL,
+        "Locked cells as a read-only HEIGHT x WIDTH view of shapes, 0 if empty.", NULL},
+    {"rows", (getter) py_game_get_rows, NULL,
+        "Locked cells as a read-only view of HEIGHT row masks, bit j is column j.", NULL},
+    {"piece", (getter) py_game_get_piece, NULL,
+        "Falling piece as a read-only view of its shape, rotation, column and row.", NULL},
+    {"score", (getter) py_game_get_int, NULL, NULL, (void *) PY_GAME_SCORE},
+    {"lines", (getter) py_game_get_int, NULL, NULL, (void *) PY_GAME_LINES},
+    {"level", (getter) py_game_get_int, NULL, NULL, (void *) PY_GAME_LEVEL},
+    {"pieces", (getter) py_game_get_int, NULL, "Pieces spawned so far.", (void *) PY_GAME_PIECES},
+    {"over", (getter) py_game_get_over, NULL, NULL, NULL},
+    {"seed", (getter) py_game_get_seed, NULL, NULL, NULL},
+    {"steps", (getter) py_game_get_steps, NULL, "Logic steps run so far.", NULL},
+    {"time", (getter) py_game_get_time, NULL, "End of the last step, in microseconds.", NULL},
+    {NULL}
+};
+
+static PyBufferProcs PY_GAME_BUFFER = {(getbufferproc) py_game_getbuffer, NULL};
+
+static PyTypeObject PY_GAME_TYPE = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tetris_engine.Game",
+    .tp_doc = PyDoc_STR(
+        "Game(seed=None, bag=False, das=167, arr=33)\n--\n\n"
+        "A game run by the C engine, das and arr are in milliseconds. It exports\n"
+        "the same buffer as its cells, so numpy.asarray(game) is the board."
+    ),
+    .tp_basicsize = sizeof(PyGame),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc) py_game_init,
+    .tp_dealloc = (destructor) py_game_dealloc,
+    .tp_methods = PY_GAME_METHODS,
+    .tp_getset = PY_GAME_GETSET,
+    .tp_as_buffer = &PY_GAME_BUFFER
+};
+
+static PyBufferProcs PY_VIEW_BUFFER = {(getbufferproc) py_view_getbuffer, NULL};
+
+static PyTypeObject PY_VIEW_TYPE = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tetris_engine.View",
+    .tp_basicsize = sizeof(PyView),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor) py_view_dealloc,
+    .tp_as_buffer = &PY_VIEW_BUFFER
+};
+
+static struct PyModuleDef PY_MODULE = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "tetris_engine",
+    .m_doc = "The rules of the C game, for Python front ends and training code.",
+    .m_size = -1
+};
+
+
+PyMODINIT_FUNC PyInit_tetris_engine(void) {
+    PyObject *m = NULL;
+
+    if (PyType_Ready(&PY_GAME_TYPE) < 0 || PyType_Ready(&PY_VIEW_TYPE) < 0) {
+        return NULL;
+    }
+    m = PyModule_Create(&PY_MODULE);
+    if (m == NULL) {
+        return NULL;
+    }
+    Py_INCREF(&PY_GAME_TYPE);
+    if (PyModule_AddObject(m, "Game", (PyObject *) &PY_GAME_TYPE) < 0) {
+        Py_DECREF(&PY_GAME_TYPE);
+        goto error;
+    }
+    if (
+        PyModule_AddIntConstant(m, "WIDTH", BOARD_WIDTH) < 0
+        || PyModule_AddIntConstant(m, "HEIGHT", BOARD_HEIGHT) < 0
+        || PyModule_AddIntConstant(m, "LOGIC_HZ", LOGIC_HZ) < 0
+        || PyModule_AddIntConstant(m, "RULES_VERSION", RULES_VERSION) < 0
+        || PyModule_AddIntConstant(m, "NPIECES", NPIECES) < 0
+        || PyModule_AddIntConstant(m, "NROTATIONS", NROTATIONS) < 0
+        || PyModule_AddIntConstant(m, "ACTION_LEFT", ACTION_LEFT) < 0
+        || PyModule_AddIntConstant(m, "ACTION_RIGHT", ACTION_RIGHT) < 0
+        || PyModule_AddIntConstant(m, "ACTION_DOWN", ACTION_DOWN) < 0
+        || PyModule_AddIntConstant(m, "ACTION_ROTATE_ANTICLOCK", ACTION_ROTATE_ANTICLOCK) < 0
+        || PyModule_AddIntConstant(m, "ACTION_ROTATE_CLOCK", ACTION_ROTATE_CLOCK) < 0
+        || PyModule_AddIntConstant(m, "EVENT_PIECE_LANDED", EVENT_PIECE_LANDED) < 0
+        || PyModule_AddIntConstant(m, "EVENT_CLEAR_ROW_ONE", EVENT_CLEAR_ROW_ONE) < 0
+        || PyModule_AddIntConstant(m, "EVENT_CLEAR_ROW_TWO", EVENT_CLEAR_ROW_TWO) < 0
+        || PyModule_AddIntConstant(m, "EVENT_CLEAR_ROW_THREE", EVENT_CLEAR_ROW_THREE) < 0
+        || PyModule_AddIntConstant(m, "EVENT_CLEAR_ROW_FOUR", EVENT_CLEAR_ROW_FOUR) < 0
+    ) {
+        goto error;
+    }
+    return m;
+
+    error:
+        Py_DECREF(m);
+        return NULL;
+}
+
+
+static PyView *py_game_cells(PyGame *self) {
+    return py_view_new(
+        self,
+        self->game.board.cells,
+        "B",
+        sizeof(uint8_t),
+        2,
+        BOARD_HEIGHT,
+        BOARD_WIDTH
+    );
+}
+
+
+static PyObject *py_game_clone(PyGame *self, PyObject *unused) {
+    PyGame *copy = PyObject_New(PyGame, Py_TYPE(self));
+
+    if (copy == NULL) {
+        return NULL;
+    }
+    copy->game = self->game;
+    copy->input = self->input;
+    copy->logic = self->logic;
+    return (PyObject *) copy;
+}
+
+
+static void py_game_dealloc(PyGame *self) {
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+
+static PyObject *py_game_drop(PyGame *self, PyObject *args) {
+    int rotation, column;
+
+    if (!PyArg_ParseTuple(args, "ii:drop", &rotation, &column)) {
+        return NULL;
+    }
+    if (rotation < 0 || rotation >= NROTATIONS) {
+        PyErr_SetString(PyExc_ValueError, "rotation out of range");
+        return NULL;
+    }
+    if (self->game.over) {
+        Py_RETURN_FALSE;
+    }
+    return PyBool_FromLong(game_drop(&self->game, rotation, column));
+}
+
+
+static PyObject *py_game_get_cells(PyGame *self, void *closure) {
+    return py_view_memory(py_game_cells(self));
+}
+
+
+static PyObject *py_game_get_int(PyGame *self, void *closure) {
+    switch ((intptr_t) closure) {
+        case PY_GAME_SCORE:
+            return PyLong_FromLong(self->game.score);
+        case PY_GAME_LINES:
+            return PyLong_FromLong(self->game.total_rows);
+        case PY_GAME_LEVEL:
+            return PyLong_FromLong(self->game.level);
+        default:
+            return PyLong_FromLong(self->game.pieces_spawned);
+    }
+}
+
+
+static PyObject *py_game_get_over(PyGame *self, void *closure) {
+    return PyBool_FromLong(self->game.over);
+}
+
+
+static PyObject *py_game_get_piece(PyGame *self, void *closure) {
+    return py_view_memory(
+        py_view_new(self, &self->game.current_piece, "i", sizeof(int), 1, PY_PIECE_FIELDS, 0)
+    );
+}
+
+
+/* the rows past the bottom are left out, they are always full */
+static PyObject *py_game_get_rows(PyGame *self, void *closure) {
+    return py_view_memory(
+        py_view_new(self, self->game.board.rows, "H", sizeof(uint16_t), 1, BOARD_HEIGHT, 0)
+    );
+}
+
+
+static PyObject *py_game_get_seed(PyGame *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(self->game.seed);
+}
+
+
+static PyObject *py_game_get_steps(PyGame *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(self->logic.steps);
+}
+
+
+static PyObject *py_game_get_time(PyGame *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(logic_time(&self->logic));
+}
+
+
+/* the game exports the same buffer as its cells attribute */
+static int py_game_getbuffer(PyGame *self, Py_buffer *view, int flags) {
+    PyView *cells = py_game_cells(self);
+    int result;
+
+    if (cells == NULL) {
+        view->obj = NULL;
+        return -1;
+    }
+    result = py_view_getbuffer(cells, view, flags);
+    Py_DECREF(cells);
+    return result;
+}
+
+
+/* the clock starts at 0 and only moves with the steps, so that a game plays
+ * out the same whatever the speed it is run at */
+static int py_game_init(PyGame *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"seed", "bag", "das", "arr", NULL};
+    PyObject *seed = Py_None;
+    int bag = 0;
+    unsigned int das = PY_DEFAULT_DAS;
+    unsigned int arr = PY_DEFAULT_ARR;
+    uint64_t s = time(NULL);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OpII:Game", keywords, &seed, &bag, &das, &arr)) {
+        return -1;
+    }
+    if (seed != Py_None && !py_seed(seed, &s)) {
+        return -1;
+    }
+    game_init(&self->game, s, bag ? RANDOMIZER_BAG : RANDOMIZER_UNIFORM);
+    input_init(&self->input, das * 1000, arr * 1000);
+    logic_init(&self->logic, 0);
+    return 0;
+}
+
+
+static PyObject *py_game_key(PyGame *self, PyObject *arg, bool pressed) {
+    long action = PyLong_AsLong(arg);
+
+    if (action == -1 && PyErr_Occurred()) {
+        return NULL;
+    }
+    if (action < 0 || action >= NACTIONS) {
+        PyErr_SetString(PyExc_ValueError, "unknown action");
+        return NULL;
+    }
+    if (!input_push(&self->input, action, pressed, logic_time(&self->logic))) {
+        PyErr_SetString(PyExc_RuntimeError, "too many keys waiting, run some steps");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+
+static PyObject *py_game_playfield(PyGame *self, PyObject *unused) {
+    uint8_t cells[BOARD_HEIGHT][BOARD_WIDTH];
+    playfield_cells(&self->game, cells);
+    return PyBytes_FromStringAndSize((const char *) cells, sizeof(cells));
+}
+
+
+static PyObject *py_game_press(PyGame *self, PyObject *action) {
+    return py_game_key(self, action, true);
+}
+
+
+static PyObject *py_game_release(PyGame *self, PyObject *action) {
+    return py_game_key(self, action, false);
+}
+
+
+static PyObject *py_game_reset(PyGame *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"seed", NULL};
+    PyObject *seed = Py_None;
+    uint64_t s;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O:reset", keywords, &seed)) {
+        return NULL;
+    }
+    if (seed == Py_None) {
+        s = rng_next(&self->game.rng);
+    }
+    else if (!py_seed(seed, &s)) {
+        return NULL;
+    }
+    game_init(&self->game, s, self->game.randomizer);
+    input_init(&self->input, self->input.das, self->input.arr);
+    logic_init(&self->logic, 0);
+    Py_RETURN_NONE;
+}
+
+
+/* events are cleared as they are returned, as the C game does when it plays
+ * the sounds */
+static PyObject *py_game_step(PyGame *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"n", NULL};
+    Py_ssize_t n = 1;
+    uint32_t events;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|n:step", keywords, &n)) {
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < n && !self->game.over; i++) {
+        logic_step(&self->logic, &self->game, &self->input);
+    }
+    events = self->game.events;
+    self->game.events = 0;
+    return PyLong_FromUnsignedLong(events);
+}
+
+
+/* any Python integer, taken modulo 2^64 */
+static bool py_seed(PyObject *seed, uint64_t *s) {
+    *s = PyLong_AsUnsignedLongLongMask(seed);
+    return !PyErr_Occurred();
+}
+
+
+static void py_view_dealloc(PyView *self) {
+    Py_XDECREF(self->owner);
+    PyObject_Free(self);
+}
+
+
+static int py_view_getbuffer(PyView *self, Py_buffer *view, int flags) {
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "game views are read-only");
+        view->obj = NULL;
+        return -1;
+    }
+    view->buf = self->data;
+    view->obj = (PyObject *) self;
+    Py_INCREF(self);
+    view->len = self->itemsize;
+    for (int i = 0; i < self->ndim; i++) {
+        view->len *= self->shape[i];
+    }
+    view->readonly = 1;
+    view->itemsize = self->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? self->format : NULL;
+    view->ndim = self->ndim;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+
+/* a memoryview of a view, which it takes over */
+static PyObject *py_view_memory(PyView *v) {
+    PyObject *memory;
+
+    if (v == NULL) {
+        return NULL;
+    }
+    memory = PyMemoryView_FromObject((PyObject *) v);
+    Py_DECREF(v);
+    return memory;
+}
+
+
+/* a view of ndim dimensions (1 or 2) over data, which lives in owner, the
+ * second size is ignored for one dimension */
+static PyView *py_view_new(
+    PyGame *owner,
+    void *data,
+    char *format,
+    Py_ssize_t itemsize,
+    int ndim,
+    Py_ssize_t rows,
+    Py_ssize_t columns
+) {
+    PyView *v = PyObject_New(PyView, &PY_VIEW_TYPE);
+
+    if (v == NULL) {
+        return NULL;
+    }
+    Py_INCREF(owner);
+    v->owner = owner;
+    v->data = data;
+    v->format = format;
+    v->itemsize = itemsize;
+    v->ndim = ndim;
+    v->shape[0] = rows;
+    v->shape[1] = columns;
+    v->strides[0] = ndim == 2 ? columns * itemsize : itemsize;
+    v->strides[1] = itemsize;
+    return v;
+}
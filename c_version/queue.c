@@ -0,0 +1,137 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "queue.h"
+
+
+#define CACHE_LINE 64
+
+
+/* each cell has a sequence number telling whose turn it is: a cell is free
+ * for the push of position p when it holds p, and ready for the pop of
+ * position p when it holds p + 1 */
+typedef struct cell {
+    _Atomic uint64_t sequence;
+} Cell;
+
+struct queue {
+    _Atomic uint64_t tail __attribute__((aligned(CACHE_LINE)));  /* next push */
+    _Atomic uint64_t head __attribute__((aligned(CACHE_LINE)));  /* next pop */
+    uint64_t mask __attribute__((aligned(CACHE_LINE)));
+    size_t item_size;
+    size_t cell_size;  /* sequence then item, rounded up to 8 bytes */
+    uint8_t *cells;
+};
+
+
+static Cell *cell_at(Queue *, uint64_t);
+
+
+void queue_free(Queue *q) {
+    if (q == NULL) {
+        return;
+    }
+    free(q->cells);
+    free(q);
+}
+
+
+/* capacity is rounded up to a power of two */
+Queue *queue_new(size_t capacity, size_t item_size) {
+    Queue *q = NULL;
+    size_t n = 1;
+
+    while (n < capacity) {
+        n *= 2;
+    }
+    check(posix_memalign((void **) &q, CACHE_LINE, sizeof(Queue)) == 0, "Failed to allocate queue");
+    memset(q, 0, sizeof(Queue));
+    q->mask = n - 1;
+    q->item_size = item_size;
+    q->cell_size = (sizeof(Cell) + item_size + 7) & ~(size_t) 7;
+    q->cells = malloc(n * q->cell_size);
+    check_mem(q->cells);
+    for (size_t i = 0; i < n; i++) {
+        atomic_init(&cell_at(q, i)->sequence, i);
+    }
+    return q;
+
+    error:
+        queue_free(q);
+        return NULL;
+}
+
+
+/* take the oldest item, returns false if the queue is empty */
+bool queue_pop(Queue *q, void *item) {
+    uint64_t position = atomic_load_explicit(&q->head, memory_order_relaxed);
+    Cell *c;
+
+    for (;;) {
+        c = cell_at(q, position);
+        uint64_t sequence = atomic_load_explicit(&c->sequence, memory_order_acquire);
+        int64_t diff = (int64_t) (sequence - (position + 1));
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                &q->head,
+                &position,
+                position + 1,
+                memory_order_relaxed,
+                memory_order_relaxed
+            )) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return false;
+        }
+        else {
+            position = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+    memcpy(item, c + 1, q->item_size);
+    atomic_store_explicit(&c->sequence, position + q->mask + 1, memory_order_release);
+    return true;
+}
+
+
+/* returns false if the queue is full */
+bool queue_push(Queue *q, const void *item) {
+    uint64_t position = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    Cell *c;
+
+    for (;;) {
+        c = cell_at(q, position);
+        uint64_t sequence = atomic_load_explicit(&c->sequence, memory_order_acquire);
+        int64_t diff = (int64_t) (sequence - position);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                &q->tail,
+                &position,
+                position + 1,
+                memory_order_relaxed,
+                memory_order_relaxed
+            )) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return false;
+        }
+        else {
+            position = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+    memcpy(c + 1, item, q->item_size);
+    atomic_store_explicit(&c->sequence, position + 1, memory_order_release);
+    return true;
+}
+
+
+static Cell *cell_at(Queue *q, uint64_t position) {
+    return (Cell *) (q->cells + (position & q->mask) * q->cell_size);
+}
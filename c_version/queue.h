@@ -0,0 +1,18 @@
+#ifndef __queue_h__
+#define __queue_h__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/* bounded lock-free queue of fixed size items, any number of threads can
+ * push and pop at the same time */
+typedef struct queue Queue;
+
+
+void queue_free(Queue *);
+Queue *queue_new(size_t, size_t);
+bool queue_pop(Queue *, void *);
+bool queue_push(Queue *, const void *);
+
+#endif
@@ -0,0 +1,303 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "board.h"
+#include "engine.h"
+#include "input.h"
+#include "placement.h"
+#include "reach.h"
+
+
+#define STATE_COLUMNS ((1u << PLACEMENT_COLUMNS) - 1)
+
+
+static void add_placement(Reach *, uint32_t (*)[REACH_ROWS], int, int, int, int, int);
+static void canonical_rotations(int, int *);
+static void fit_masks(const Board *, int, Reach *);
+static inline void mark(Reach *, int, int, uint32_t, int);
+static inline bool visit(Reach *, uint32_t (*)[REACH_ROWS], int, int, uint32_t, int);
+
+
+/* write the inputs that take the piece from where it spawned to a placement
+ * and lock it there, in order, to actions; returns how many there are,
+ * which may be more than max, in which case only the first max are written;
+ * each state only keeps the input that led to it, the state before is found
+ * by undoing that input */
+int reach_path(const Reach *reach, const ReachPlacement *p, uint8_t *actions, int max) {
+    int n = p->length;
+    int r = p->rotation;
+    int y = p->posy;
+    int c = p->posx - PLACEMENT_MIN_X;
+
+    if (n - 1 < max) {
+        actions[n - 1] = ACTION_DOWN;
+    }
+    for (int i = n - 2; i >= 0; i--) {
+        int a = 0;
+        for (int k = 0; k < REACH_ACTION_BITS; k++) {
+            a |= (reach->action[k][r][y] >> c & 1) << k;
+        }
+        if (i < max) {
+            actions[i] = a;
+        }
+        switch (a) {
+            case ACTION_LEFT:
+                c++;
+                break;
+            case ACTION_RIGHT:
+                c--;
+                break;
+            case ACTION_DOWN:
+                y--;
+                break;
+            case ACTION_ROTATE_ANTICLOCK:
+                r = (r + 1) % NROTATIONS;
+                break;
+            case ACTION_ROTATE_CLOCK:
+                r = (r + NROTATIONS - 1) % NROTATIONS;
+                break;
+        }
+    }
+    return n;
+}
+
+
+/* find every placement the piece can lock at through left, right, down and
+ * rotation inputs, with the same collision rules as the game: rotations that
+ * collide are undone, not kicked; nothing is allocated, the whole search
+ * works in reach
+ *
+ * the search is breadth first, one input at a time for all the states of
+ * the frontier at once: a row of states is a bit mask of columns, so moving
+ * left or right is a shift, and the states an input leads to are masked
+ * with where the piece fits and what was not visited yet
+ *
+ * the rows from the start one down to band, where every orientation fits
+ * at the same columns (the empty rows above the stack), are not searched
+ * one by one: a state there is as far as the same state of the start row
+ * plus the rows in between, so the states reached on the start row drop
+ * straight to band and join the frontier there that many inputs later */
+void reach_search(const Board *b, const Piece *start, Reach *reach) {
+    uint32_t frontier[2][NROTATIONS][REACH_ROWS];
+    uint32_t locked[NROTATIONS][REACH_ROWS];
+    uint32_t pending[REACH_ROWS][NROTATIONS];  /* due on row band, by depth modulo REACH_ROWS */
+    uint32_t (*fit)[REACH_ROWS];
+    int canonical[NROTATIONS];
+    int c = start->posx - PLACEMENT_MIN_X;
+    int ymin = start->posy, ymax = start->posy;  /* rows the frontier spans */
+    int band = start->posy;
+    int last = -1;  /* depth the last pending states are due at */
+
+    reach->shape = start->shape;
+    reach->nplacements = 0;
+    if (start->posy < 0 || start->posy >= REACH_ROWS || c < 0 || c >= PLACEMENT_COLUMNS) {
+        return;
+    }
+    fit_masks(b, start->shape, reach);
+    fit = reach->fit[start->shape - 1];
+    if (!(fit[start->rotation][start->posy] & (1u << c))) {
+        return;
+    }
+    canonical_rotations(start->shape, canonical);
+    memset(reach->visited, 0, sizeof(reach->visited));
+    memset(frontier, 0, sizeof(frontier));
+    memset(locked, 0, sizeof(locked));
+    memset(pending, 0, sizeof(pending));
+    reach->visited[start->rotation][start->posy] = 1u << c;
+    frontier[0][start->rotation][start->posy] = 1u << c;
+    while (band + 1 < REACH_ROWS) {
+        bool same = true;
+        for (int r = 0; r < NROTATIONS; r++) {
+            same = same && fit[r][band + 1] == fit[r][start->posy];
+        }
+        if (!same) {
+            break;
+        }
+        band++;
+    }
+
+    for (int depth = 0; ymin <= ymax || depth <= last; depth++) {
+        uint32_t (*current)[REACH_ROWS] = frontier[depth & 1];
+        uint32_t (*next)[REACH_ROWS] = frontier[(depth + 1) & 1];
+        int lo = ymin, hi = ymax;
+
+        for (int r = 0; r < NROTATIONS; r++) {
+            uint32_t *due = &pending[depth % REACH_ROWS][r];
+            if (*due != 0) {
+                current[r][band] |= *due;
+                *due = 0;
+                lo = band < lo ? band : lo;
+                hi = band > hi ? band : hi;
+            }
+        }
+        ymin = REACH_ROWS;
+        ymax = -1;
+        for (int y = lo; y <= hi; y++) {
+            /* the rows inside the band never hold any state */
+            if (y == start->posy + 1 && y < band) {
+                y = band;
+            }
+            for (int r = 0; r < NROTATIONS; r++) {
+                uint32_t f = current[r][y];
+                if (f == 0) {
+                    continue;
+                }
+                current[r][y] = 0;
+                uint32_t below = y + 1 < REACH_ROWS ? fit[r][y + 1] : 0;
+
+                /* moving down collides: the piece lands there */
+                for (uint32_t m = f & ~below; m != 0; m &= m - 1) {
+                    add_placement(reach, locked, canonical[r], r, y, __builtin_ctz(m), depth + 1);
+                }
+                int n = visit(reach, next, r, y, f >> 1, ACTION_LEFT)
+                    | visit(reach, next, r, y, f << 1, ACTION_RIGHT)
+                    | visit(reach, next, (r + NROTATIONS - 1) % NROTATIONS, y, f, ACTION_ROTATE_ANTICLOCK)
+                    | visit(reach, next, (r + 1) % NROTATIONS, y, f, ACTION_ROTATE_CLOCK);
+                if (n) {
+                    ymin = y < ymin ? y : ymin;
+                    ymax = y > ymax ? y : ymax;
+                }
+                if (y == start->posy && band > y) {
+                    uint32_t m = f & ~reach->visited[r][y + 1];
+                    for (int k = y + 1; k <= band; k++) {
+                        mark(reach, r, k, m, ACTION_DOWN);
+                    }
+                    pending[(depth + band - y) % REACH_ROWS][r] |= m;
+                    last = depth + band - y > last ? depth + band - y : last;
+                }
+                else if (y + 1 < REACH_ROWS && visit(reach, next, r, y + 1, f, ACTION_DOWN)) {
+                    ymin = y + 1 < ymin ? y + 1 : ymin;
+                    ymax = y + 1 > ymax ? y + 1 : ymax;
+                }
+            }
+        }
+    }
+}
+
+
+/* record a placement unless one with the same cells was already found,
+ * orientations with the same cells share the bits of their canonical one in
+ * locked, indexed by the top left cell of the piece */
+static void add_placement(
+    Reach *reach,
+    uint32_t (*locked)[REACH_ROWS],
+    int canonical,
+    int r,
+    int y,
+    int c,
+    int length
+) {
+    const Rotation *rot = &PIECE_ROTATIONS[reach->shape - 1][r];
+    uint32_t left = 1u << (c + rot->minx);
+    int top = y + rot->miny;
+
+    if (locked[canonical][top] & left) {
+        return;
+    }
+    locked[canonical][top] |= left;
+    ReachPlacement *p = &reach->placements[reach->nplacements++];
+    p->posx = c + PLACEMENT_MIN_X;
+    p->posy = y;
+    p->rotation = r;
+    p->length = length;
+}
+
+
+/* canonical[r] is the first orientation of the shape with the same cells as
+ * orientation r once both are moved to the top left corner */
+static void canonical_rotations(int shape, int *canonical) {
+    const Rotation *rotations = PIECE_ROTATIONS[shape - 1];
+
+    for (int r = 0; r < NROTATIONS; r++) {
+        canonical[r] = r;
+        for (int k = 0; k < r && canonical[r] == r; k++) {
+            const Rotation *a = &rotations[r], *b = &rotations[k];
+            bool same = a->maxx - a->minx == b->maxx - b->minx
+                && a->maxy - a->miny == b->maxy - b->miny;
+            for (int i = 0; same && i <= a->maxy - a->miny; i++) {
+                same = (a->rows[a->miny + i] >> a->minx) == (b->rows[b->miny + i] >> b->minx);
+            }
+            if (same) {
+                canonical[r] = k;
+            }
+        }
+    }
+}
+
+
+/* columns where each orientation fits at each row, all at once: column c of
+ * a state is posx c - 3, so a piece cell in column k of the matrix is blocked
+ * there if bit c - 3 + k + BOARD_PAD = c + k + 1 of the padded board row is
+ * set, and shifting the padded row right by k + 1 gives the blocked columns
+ * for that cell; rows over the empty top of the board are all blocked by the
+ * walls only, which is worked out once per orientation, and nothing is done
+ * if the masks are already there for this board */
+static void fit_masks(const Board *b, int shape, Reach *reach) {
+    uint32_t (*fit)[REACH_ROWS] = reach->fit[shape - 1];
+    uint32_t padded[BOARD_HEIGHT + BOARD_PIECE_ROWS];
+    int top = 0;  /* first row that is not empty */
+
+    if (reach->fit_known & (1u << (shape - 1)) && reach->fit_hash[shape - 1] == b->hash) {
+        return;
+    }
+    while (top < BOARD_HEIGHT && b->rows[top] == 0) {
+        top++;
+    }
+    for (int i = 0; i < BOARD_HEIGHT + BOARD_PIECE_ROWS; i++) {
+        padded[i] = ((uint32_t) b->rows[i] << BOARD_PAD) | BOARD_WALLS;
+    }
+    for (int r = 0; r < NROTATIONS; r++) {
+        const uint16_t *rows = PIECE_ROTATIONS[shape - 1][r].rows;
+        uint32_t walls = 0;
+        for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+            for (uint32_t m = rows[i]; m != 0; m &= m - 1) {
+                walls |= BOARD_WALLS >> (__builtin_ctz(m) + 1);
+            }
+        }
+        for (int y = 0; y < REACH_ROWS; y++) {
+            uint32_t blocked = walls;
+            if (y + BOARD_PIECE_ROWS > top) {
+                for (int i = 0; i < BOARD_PIECE_ROWS; i++) {
+                    for (uint32_t m = rows[i]; m != 0; m &= m - 1) {
+                        blocked |= padded[y + i] >> (__builtin_ctz(m) + 1);
+                    }
+                }
+            }
+            fit[r][y] = ~blocked & STATE_COLUMNS;
+        }
+    }
+    reach->fit_hash[shape - 1] = b->hash;
+    reach->fit_known |= 1u << (shape - 1);
+}
+
+
+/* mark states of row (r, y) as visited through the given input, one bit of
+ * it per plane */
+static inline void mark(Reach *reach, int r, int y, uint32_t m, int action) {
+    reach->visited[r][y] |= m;
+    for (int k = 0; k < REACH_ACTION_BITS; k++) {
+        reach->action[k][r][y] = (reach->action[k][r][y] & ~m) | (action & (1 << k) ? m : 0);
+    }
+}
+
+
+/* add the states of row (r, y) in candidates that the piece fits in and that
+ * were not visited yet to the next frontier, remembering the input that led
+ * there; returns whether there were any */
+static inline bool visit(
+    Reach *reach,
+    uint32_t (*next)[REACH_ROWS],
+    int r,
+    int y,
+    uint32_t candidates,
+    int action
+) {
+    uint32_t m = candidates & reach->fit[reach->shape - 1][r][y] & ~reach->visited[r][y];
+    if (m == 0) {
+        return false;
+    }
+    mark(reach, r, y, m, action);
+    next[r][y] |= m;
+    return true;
+}
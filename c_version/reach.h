@@ -0,0 +1,49 @@
+#ifndef __reach_h__
+#define __reach_h__
+
+#include <stdint.h>
+
+#include "board.h"
+#include "engine.h"
+#include "input.h"
+#include "placement.h"
+
+
+/* a piece at posy can go from row 0 down to BOARD_HEIGHT, where its top row
+ * sits on the floor */
+#define REACH_ROWS (BOARD_HEIGHT + 1)
+#define REACH_STATES (NROTATIONS * REACH_ROWS * PLACEMENT_COLUMNS)
+#define REACH_ACTION_BITS 3  /* enough for the NACTIONS inputs */
+
+
+/* a spot where the piece can lock, different orientations covering the same
+ * cells count once */
+typedef struct reach_placement {
+    int8_t posx;
+    int8_t posy;
+    int8_t rotation;
+    uint8_t length;  /* inputs to lock it there, including the last ACTION_DOWN */
+} ReachPlacement;
+
+/* every state (rotation, posy, posx) the piece can be moved to from where it
+ * spawned, found breadth first so that the path to each state is one of the
+ * shortest; column c of a state is posx c + PLACEMENT_MIN_X, and only states
+ * marked in visited have a meaningful action; must start zeroed, the masks of
+ * where each shape fits are kept for the next search of the same board */
+typedef struct reach {
+    int shape;
+    uint32_t fit[NPIECES][NROTATIONS][REACH_ROWS];  /* bit c set if the piece fits at column c */
+    uint64_t fit_hash[NPIECES];  /* hash of the board fit[shape - 1] is for */
+    uint8_t fit_known;  /* bit shape - 1 set once fit[shape - 1] was computed */
+    uint32_t visited[NROTATIONS][REACH_ROWS];
+    /* input that led to each state, bit k of it in action[k] */
+    uint32_t action[REACH_ACTION_BITS][NROTATIONS][REACH_ROWS];
+    int nplacements;
+    ReachPlacement placements[REACH_STATES];
+} Reach;
+
+
+int reach_path(const Reach *, const ReachPlacement *, uint8_t *, int);
+void reach_search(const Board *, const Piece *, Reach *);
+
+#endif
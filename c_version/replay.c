@@ -0,0 +1,246 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "engine.h"
+#include "input.h"
+#include "logic.h"
+#include "replay.h"
+
+
+static void flush(Recorder *);
+static bool get_varint(const uint8_t **, const uint8_t *, uint64_t *);
+static uint8_t *put_varint(uint8_t *, uint64_t);
+static uint8_t *start_record(Recorder *, const Logic *, int);
+
+
+/* write the last record and the results, then close the file, returns
+ * false if any part of the game could not be written */
+bool replay_end(Recorder *r, const Logic *l, const Game *g) {
+    ReplayResult result = {
+        g->score,
+        g->total_rows,
+        g->level,
+        g->pieces_spawned,
+        r->events,
+        l->steps
+    };
+
+    if (r->fp == NULL) {
+        return false;
+    }
+    uint8_t *p = start_record(r, l, RECORD_END);
+    r->used = p - r->buffer;
+    flush(r);
+    if (!r->failed && fwrite(&result, sizeof(ReplayResult), 1, r->fp) != 1) {
+        r->failed = true;
+    }
+    if (fclose(r->fp) != 0) {
+        r->failed = true;
+    }
+    r->fp = NULL;
+    return !r->failed;
+}
+
+
+void replay_event(Recorder *r, const Logic *l, int action, bool pressed, uint64_t time) {
+    int64_t offset = (int64_t) (time - logic_time(l));
+
+    if (r->fp == NULL || r->failed) {
+        return;
+    }
+    uint8_t *p = start_record(r, l, RECORD_EVENT);
+    *p++ = action | (pressed ? 0x80 : 0);
+    p = put_varint(p, ((uint64_t) offset << 1) ^ (uint64_t) (offset >> 63));
+    r->used = p - r->buffer;
+    r->events++;
+}
+
+
+void replay_free(Recorder *r) {
+    if (r != NULL && r->fp != NULL) {
+        fclose(r->fp);
+    }
+    free(r);
+}
+
+
+bool replay_matches(const ReplayResult *a, const ReplayResult *b) {
+    return a->score == b->score
+        && a->lines == b->lines
+        && a->level == b->level
+        && a->pieces == b->pieces
+        && a->events == b->events
+        && a->steps == b->steps;
+}
+
+
+/* open the file and write the header, the game, input and clock must be in
+ * the state they start from */
+Recorder *replay_new(const char *path, const Game *g, const Input *in, const Logic *l) {
+    ReplayHeader header;
+    Recorder *r = calloc(1, sizeof(Recorder));
+    check_mem(r);
+
+    memset(&header, 0, sizeof(ReplayHeader));
+    memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_VERSION;
+    header.rules = RULES_VERSION;
+    header.logic_hz = LOGIC_HZ;
+    header.randomizer = g->randomizer;
+    header.seed = g->seed;
+    header.start = l->start;
+    header.das = in->das;
+    header.arr = in->arr;
+
+    r->fp = fopen(path, "wb");
+    check(r->fp != NULL, "Failed to open %s", path);
+    /* the buffer of the recorder is the only one, stdio would allocate its
+     * own on the first write */
+    setvbuf(r->fp, NULL, _IONBF, 0);
+    check(fwrite(&header, sizeof(ReplayHeader), 1, r->fp) == 1, "Failed to write %s", path);
+    r->steps = l->steps;
+    return r;
+
+    error:
+        replay_free(r);
+        return NULL;
+}
+
+
+/* run the game a replay holds and fill in the results it recorded and the
+ * ones the replay led to, returns false if the data is not a valid replay
+ * for this engine */
+bool replay_play(
+    const uint8_t *data,
+    size_t size,
+    ReplayResult *recorded,
+    ReplayResult *replayed
+) {
+    const uint8_t *p = data + sizeof(ReplayHeader);
+    const uint8_t *end = data + size;
+    ReplayHeader header;
+    Game g;
+    Input in;
+    Logic l;
+
+    check(size >= sizeof(ReplayHeader), "Replay too short");
+    memcpy(&header, data, sizeof(ReplayHeader));
+    check(memcmp(header.magic, REPLAY_MAGIC, sizeof(header.magic)) == 0, "Not a replay");
+    check(header.version == REPLAY_VERSION, "Unsupported replay format %d", header.version);
+    check(
+        header.rules == RULES_VERSION && header.logic_hz == LOGIC_HZ,
+        "Replay recorded with rules %d at %u Hz, this game has rules %d at %d Hz",
+        header.rules,
+        header.logic_hz,
+        RULES_VERSION,
+        LOGIC_HZ
+    );
+
+    game_init(&g, header.seed, header.randomizer);
+    input_init(&in, header.das, header.arr);
+    logic_init(&l, header.start);
+    memset(replayed, 0, sizeof(ReplayResult));
+    for (;;) {
+        uint64_t head, value;
+        check(get_varint(&p, end, &head), "Truncated replay");
+        for (uint64_t i = head >> 2; i > 0 && !g.over; i--) {
+            logic_step(&l, &g, &in);
+        }
+
+        if ((head & 3) == RECORD_EVENT) {
+            check(p < end, "Truncated replay");
+            int action = *p & 0x7F;
+            bool pressed = *p & 0x80;
+            p++;
+            check(action < NACTIONS, "Unknown action %d in replay", action);
+            check(get_varint(&p, end, &value), "Truncated replay");
+            int64_t offset = (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+            input_push(&in, action, pressed, logic_time(&l) + offset);
+            replayed->events++;
+        }
+        else if ((head & 3) == RECORD_SKIP) {
+            check(get_varint(&p, end, &value), "Truncated replay");
+            logic_skip(&l, value);
+        }
+        else if ((head & 3) == RECORD_END) {
+            check((size_t) (end - p) >= sizeof(ReplayResult), "Truncated replay");
+            memcpy(recorded, p, sizeof(ReplayResult));
+            break;
+        }
+        else {
+            sentinel("Unknown record in replay");
+        }
+    }
+
+    replayed->score = g.score;
+    replayed->lines = g.total_rows;
+    replayed->level = g.level;
+    replayed->pieces = g.pieces_spawned;
+    replayed->steps = l.steps;
+    return true;
+
+    error:
+        return false;
+}
+
+
+/* the clock jumped forward by time microseconds */
+void replay_skip(Recorder *r, const Logic *l, uint64_t time) {
+    if (r->fp == NULL || r->failed) {
+        return;
+    }
+    uint8_t *p = start_record(r, l, RECORD_SKIP);
+    p = put_varint(p, time);
+    r->used = p - r->buffer;
+}
+
+
+/* write out the buffered records, a failed write stops the recording but
+ * not the game */
+static void flush(Recorder *r) {
+    if (r->used > 0 && !r->failed && fwrite(r->buffer, 1, r->used, r->fp) != r->used) {
+        log_warn("Failed to write replay, recording stopped");
+        r->failed = true;
+    }
+    r->used = 0;
+}
+
+
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        *v |= (uint64_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/* 7 bits per byte, low bits first, the high bit is set on all but the last */
+static uint8_t *put_varint(uint8_t *p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+
+/* make room for a record and write its head, returns where the rest of it
+ * goes */
+static uint8_t *start_record(Recorder *r, const Logic *l, int kind) {
+    if (REPLAY_BUFFER - r->used < REPLAY_MAX_RECORD) {
+        flush(r);
+    }
+    uint8_t *p = put_varint(r->buffer + r->used, (l->steps - r->steps) << 2 | kind);
+    r->steps = l->steps;
+    return p;
+}
@@ -0,0 +1,73 @@
+#ifndef __replay_h__
+#define __replay_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "engine.h"
+#include "input.h"
+#include "logic.h"
+
+
+#define REPLAY_MAGIC "TRPL"
+#define REPLAY_VERSION 1  /* of the file format, RULES_VERSION is the game's */
+#define REPLAY_BUFFER 4096  /* records are written out when this fills */
+#define REPLAY_MAX_RECORD 24  /* longest encoded record */
+
+
+/* what follows the header is a list of records, each starts with a varint
+ * holding the number of logic steps run since the previous record and the
+ * kind of record in its 2 low bits */
+enum REPLAY_RECORDS {
+    RECORD_EVENT,  /* then a byte with the action and 0x80 if pressed, and a
+                    * zigzag varint with the time of the event relative to
+                    * the end of the last step */
+    RECORD_SKIP,  /* then a varint with the time the clock skipped */
+    RECORD_END  /* then the ReplayResult of the game */
+};
+
+
+/* all integers in host byte order */
+typedef struct replay_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t rules;  /* RULES_VERSION of the engine that recorded the game */
+    uint32_t logic_hz;
+    uint32_t randomizer;
+    uint64_t seed;
+    uint64_t start;  /* time of logic step 0, in microseconds */
+    uint32_t das;
+    uint32_t arr;
+} ReplayHeader;
+
+typedef struct replay_result {
+    uint32_t score;
+    uint32_t lines;
+    uint32_t level;
+    uint32_t pieces;
+    uint32_t events;  /* input events recorded */
+    uint32_t steps;  /* logic steps run */
+} ReplayResult;
+
+/* writes a game out as it is played, records go to a fixed buffer so that
+ * nothing is allocated while the game runs */
+typedef struct recorder {
+    FILE *fp;
+    uint64_t steps;  /* logic step of the last record */
+    uint32_t events;
+    bool failed;  /* a write failed, the rest of the game is not recorded */
+    size_t used;
+    uint8_t buffer[REPLAY_BUFFER];
+} Recorder;
+
+
+bool replay_end(Recorder *, const Logic *, const Game *);
+void replay_event(Recorder *, const Logic *, int, bool, uint64_t);
+void replay_free(Recorder *);
+bool replay_matches(const ReplayResult *, const ReplayResult *);
+Recorder *replay_new(const char *, const Game *, const Input *, const Logic *);
+bool replay_play(const uint8_t *, size_t, ReplayResult *, ReplayResult *);
+void replay_skip(Recorder *, const Logic *, uint64_t);
+
+#endif
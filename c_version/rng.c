@@ -0,0 +1,48 @@
+#include <stdint.h>
+
+#include "rng.h"
+
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+
+/* uniform integer in [0, n) without modulo bias (Lemire's method) */
+uint32_t rng_below(Rng *r, uint32_t n) {
+    uint64_t m = (uint64_t) (uint32_t) (rng_next(r) >> 32) * n;
+    if ((uint32_t) m < n) {
+        uint32_t threshold = -n % n;
+        while ((uint32_t) m < threshold) {
+            m = (uint64_t) (uint32_t) (rng_next(r) >> 32) * n;
+        }
+    }
+    return m >> 32;
+}
+
+
+uint64_t rng_next(Rng *r) {
+    uint64_t *s = r->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+
+/* expand a 64-bit seed into the full state with splitmix64, so that close
+ * seeds (e.g. base + game index) still give unrelated sequences */
+void rng_seed(Rng *r, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        r->s[i] = z ^ (z >> 31);
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef __rng_h__
+#define __rng_h__
+
+#include <stdint.h>
+
+
+/* xoshiro256** state, small enough to live inside each game */
+typedef struct rng {
+    uint64_t s[4];
+} Rng;
+
+
+uint32_t rng_below(Rng *, uint32_t);
+uint64_t rng_next(Rng *);
+void rng_seed(Rng *, uint64_t);
+
+#endif
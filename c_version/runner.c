@@ -0,0 +1,172 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "engine.h"
+#include "placement.h"
+#include "threadpool.h"
+
+
+#define DEFAULT_GAMES 1000
+#define DEFAULT_MAX_PIECES 10000
+
+
+typedef struct result {
+    uint64_t seed;
+    int score;
+    int lines;
+    int level;
+    int pieces;
+} Result;
+
+typedef struct batch {
+    Result *results;
+    uint64_t base_seed;
+    int max_pieces;
+    int randomizer;
+    const BoardOps *ops;  /* size of the boards played on */
+} Batch;
+
+
+void play_game(void *, int64_t, int);
+void usage(char *);
+
+
+void play_game(void *arg, int64_t index, int worker) {
+    Batch *batch = arg;
+    Result *result = &batch->results[index];
+    Game g;
+
+    result->seed = batch->base_seed + index;
+    game_init_size(&g, batch->ops, result->seed, batch->randomizer);
+    while (!g.over && g.pieces_spawned < batch->max_pieces) {
+        if (!placement_greedy(&g)) {
+            g.over = true;
+        }
+    }
+    result->score = g.score;
+    result->lines = g.total_rows;
+    result->level = g.level;
+    result->pieces = g.pieces_spawned;
+}
+
+
+void usage(char *name) {
+    fprintf(
+        stderr,
+        "usage: %s [-n games] [-j threads] [-s seed] [-p max pieces] [-b] [-w size] [-o output]\n"
+        "  -b  deal shapes from shuffled 7-piece bags\n"
+        "  -w  board WIDTHxHEIGHT, one of",
+        name
+    );
+    for (int i = 0; i < NBOARD_SIZES; i++) {
+        fprintf(stderr, " %s", BOARD_SIZES[i]->name);
+    }
+    fprintf(stderr, " (default %s)\n", board_ops.name);
+}
+
+
+int main(int argc, char *argv[]) {
+    int ngames = DEFAULT_GAMES;
+    int nthreads = 0;
+    char *output = NULL;
+    FILE *fp = stdout;
+    Pool *pool = NULL;
+    Batch batch = {NULL, time(NULL), DEFAULT_MAX_PIECES, RANDOMIZER_UNIFORM, &board_ops};
+    struct timespec start, end;
+    int width, height;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:j:s:p:bw:o:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                ngames = atoi(optarg);
+                break;
+            case 'j':
+                nthreads = atoi(optarg);
+                break;
+            case 's':
+                batch.base_seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'p':
+                batch.max_pieces = atoi(optarg);
+                break;
+            case 'b':
+                batch.randomizer = RANDOMIZER_BAG;
+                break;
+            case 'w':
+                check(sscanf(optarg, "%dx%d", &width, &height) == 2, "Bad board size %s", optarg);
+                batch.ops = board_ops_find(width, height);
+                check(batch.ops != NULL, "No %s board, see -h for the sizes", optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    check(ngames > 0, "Number of games must be positive");
+
+    batch.results = calloc(ngames, sizeof(Result));
+    check_mem(batch.results);
+    pool = pool_new(nthreads);
+    check(pool != NULL, "Failed to start thread pool");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pool_run(pool, ngames, play_game, &batch);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (output != NULL) {
+        fp = fopen(output, "w");
+        check(fp != NULL, "Failed to open %s", output);
+    }
+    fprintf(fp, "game,seed,score,lines,level,pieces\n");
+    long total_pieces = 0;
+    double total_score = 0;
+    for (int i = 0; i < ngames; i++) {
+        Result *r = &batch.results[i];
+        fprintf(
+            fp,
+            "%d,%llu,%d,%d,%d,%d\n",
+            i,
+            (unsigned long long) r->seed,
+            r->score,
+            r->lines,
+            r->level,
+            r->pieces
+        );
+        total_pieces += r->pieces;
+        total_score += r->score;
+    }
+    if (fp != stdout) {
+        fclose(fp);
+    }
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(
+        stderr,
+        "%d games of %s on %d threads in %.3f s: %.1f games/s, %.0f pieces/s, mean score %.1f\n",
+        ngames,
+        batch.ops->name,
+        pool_size(pool),
+        seconds,
+        ngames / seconds,
+        total_pieces / seconds,
+        total_score / ngames
+    );
+
+    pool_free(pool);
+    free(batch.results);
+    return 0;
+
+    error:
+        pool_free(pool);
+        free(batch.results);
+        return 1;
+}
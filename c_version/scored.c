@@ -0,0 +1,599 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "leaderboard.h"
+#include "queue.h"
+#include "scorenet.h"
+#include "scores.h"
+
+
+#define SCORED_MAX_CLIENTS 1024  /* connections with a higher fd are refused */
+#define SCORED_QUEUE_LENGTH 8192
+#define SCORED_MAX_BATCH 4096  /* requests the writer takes per commit */
+#define SCORED_MAX_SAMPLES (1 << 22)  /* commit times kept for the report */
+#define SCORED_MAX_EVENTS 64
+#define SCORED_MAX_UNSENT 1024  /* replies a client can leave unread before it is dropped */
+
+
+/* a request on its way from the connection thread to the writer */
+typedef struct pending {
+    int fd;
+    uint32_t client;  /* id of the connection, file descriptors get reused */
+    uint64_t received;  /* in microseconds */
+    ScoreRequest request;
+} Pending;
+
+/* a reply on its way back */
+typedef struct answer {
+    int fd;
+    uint32_t client;
+    ScoreReply reply;
+} Answer;
+
+/* replies are sent without blocking, what the socket does not take yet
+ * waits in out until it is writable again */
+typedef struct client {
+    uint32_t id;  /* 0 if the connection is closed */
+    size_t have;  /* bytes of the next request read so far */
+    uint8_t buffer[sizeof(ScoreRequest)];
+    uint8_t *out;  /* bytes sent to unsent are waiting, kept when the slot is reused */
+    size_t sent;
+    size_t unsent;
+    size_t capacity;
+    bool writing;  /* the socket was full, epoll reports when it is writable */
+    bool touched;  /* got replies from the batch being sent */
+    bool paused;  /* its whole request did not fit in the queue, nothing more is read */
+} Client;
+
+/* one thread serves the connections, another owns the store: requests go
+ * to it through a lock-free queue and everything it found waiting is
+ * committed at once */
+typedef struct server {
+    Scores *scores;
+    Leaderboard *leaderboard;
+    Queue *requests;
+    Queue *replies;
+    int requests_ready;  /* eventfd the writer waits on */
+    int replies_ready;  /* eventfd in the epoll set of the connection thread */
+    _Atomic bool stop;  /* set once no more requests will be queued */
+    _Atomic bool stopped;  /* set by the writer once it has answered everything */
+    Client clients[SCORED_MAX_CLIENTS];
+    int paused[SCORED_MAX_CLIENTS];  /* clients to resume once the writer took some requests */
+    int npaused;
+    uint32_t next_id;
+    Pending batch[SCORED_MAX_BATCH];
+    ScoreItem items[SCORED_MAX_BATCH];
+    uint64_t submissions;
+    uint64_t commits;
+    uint32_t *samples;  /* commit time of each submission */
+} Server;
+
+
+void client_close(Server *, int, int);
+void client_flush(Server *, int, int);
+bool client_queue(Server *, int, int, const ScoreReply *);
+void client_read(Server *, int, int);
+bool client_submit(Server *, int);
+void client_watch(Server *, int, int);
+void commit_batch(Server *, int);
+int compare_uint32(const void *, const void *);
+uint64_t now_us();
+void print_report(Server *);
+void resume_clients(Server *, int);
+void send_replies(Server *, int);
+void usage(char *);
+void *writer_loop(void *);
+
+
+void client_close(Server *s, int epoll, int fd) {
+    Client *c = &s->clients[fd];
+    epoll_ctl(epoll, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    c->id = 0;
+    c->sent = c->unsent = 0;
+    c->writing = false;
+    c->paused = false;
+}
+
+
+/* send what the socket takes of the waiting replies, and have epoll report
+ * when it can take the rest */
+void client_flush(Server *s, int epoll, int fd) {
+    Client *c = &s->clients[fd];
+
+    while (c->sent < c->unsent) {
+        ssize_t n = send(fd, c->out + c->sent, c->unsent - c->sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!c->writing) {
+                c->writing = true;
+                client_watch(s, epoll, fd);
+            }
+            return;
+        }
+        if (n < 0) {
+            log_warn("Failed to reply, client dropped");
+            client_close(s, epoll, fd);
+            return;
+        }
+        c->sent += n;
+    }
+    c->sent = c->unsent = 0;
+    if (c->writing) {
+        c->writing = false;
+        client_watch(s, epoll, fd);
+    }
+}
+
+
+/* add a reply to those waiting for the client, false if the client was
+ * dropped for leaving too many of them unread */
+bool client_queue(Server *s, int epoll, int fd, const ScoreReply *reply) {
+    Client *c = &s->clients[fd];
+
+    if (c->unsent + sizeof(ScoreReply) > c->capacity) {
+        memmove(c->out, c->out + c->sent, c->unsent - c->sent);
+        c->unsent -= c->sent;
+        c->sent = 0;
+    }
+    if (c->unsent + sizeof(ScoreReply) > c->capacity) {
+        size_t capacity = c->capacity > 0 ? 2 * c->capacity : 16 * sizeof(ScoreReply);
+        if (capacity > SCORED_MAX_UNSENT * sizeof(ScoreReply)) {
+            log_warn("Client does not read its replies, dropped");
+            client_close(s, epoll, fd);
+            return false;
+        }
+        uint8_t *out = realloc(c->out, capacity);
+        check_mem(out);
+        c->out = out;
+        c->capacity = capacity;
+    }
+    memcpy(c->out + c->unsent, reply, sizeof(ScoreReply));
+    c->unsent += sizeof(ScoreReply);
+    return true;
+
+    error:
+        client_close(s, epoll, fd);
+        return false;
+}
+
+
+/* queue every whole request the client sent, the writer is woken once; if
+ * the queue is full the request is held and the client is not read until
+ * the writer has taken some, the connection thread never waits for it */
+void client_read(Server *s, int epoll, int fd) {
+    Client *c = &s->clients[fd];
+    int queued = 0;
+
+    while (!c->paused) {
+        ssize_t n = recv(fd, c->buffer + c->have, sizeof(c->buffer) - c->have, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n <= 0) {
+            client_close(s, epoll, fd);
+            break;
+        }
+        c->have += n;
+        if (c->have < sizeof(c->buffer)) {
+            continue;
+        }
+        if (client_submit(s, fd)) {
+            queued++;
+        }
+        else {
+            c->paused = true;
+            s->paused[s->npaused++] = fd;
+            client_watch(s, epoll, fd);
+        }
+    }
+    if (queued > 0) {
+        uint64_t one = 1;
+        write(s->requests_ready, &one, sizeof(one));
+    }
+}
+
+
+/* queue the whole request of the client, false if the queue is full */
+bool client_submit(Server *s, int fd) {
+    Client *c = &s->clients[fd];
+    Pending p = {fd, c->id, now_us()};
+
+    memcpy(&p.request, c->buffer, sizeof(ScoreRequest));
+    if (!queue_push(s->requests, &p)) {
+        return false;
+    }
+    c->have = 0;
+    return true;
+}
+
+
+/* have epoll report what the client is waiting for: more requests unless
+ * it is paused, room in the socket if replies are left to send */
+void client_watch(Server *s, int epoll, int fd) {
+    Client *c = &s->clients[fd];
+    struct epoll_event event;
+
+    event.events = (c->paused ? 0 : EPOLLIN) | (c->writing ? EPOLLOUT : 0);
+    event.data.fd = fd;
+    epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &event);
+}
+
+
+/* append all the submissions of the batch in one commit, then answer every
+ * request in the order it came; once the commit is made the submissions are
+ * saved even if the leaderboard fails to take them, they are answered as
+ * unranked and the next update of the leaderboard catches up with them */
+void commit_batch(Server *s, int n) {
+    bool appended = true, ranked = true;
+    int nitems = 0;
+    for (int i = 0; i < n; i++) {
+        if (s->batch[i].request.type == REQUEST_SUBMIT) {
+            s->items[nitems++] = s->batch[i].request.item;
+        }
+    }
+    if (nitems > 0) {
+        appended = scores_append(s->scores, s->items, nitems);
+        ranked = appended && leaderboard_update(s->leaderboard, s->scores);
+        s->commits++;
+    }
+    uint64_t committed = now_us();
+    uint64_t record = s->scores->header.count - (appended ? nitems : 0);
+    uint64_t one = 1;
+
+    for (int i = 0; i < n; i++) {
+        Pending *p = &s->batch[i];
+        Answer a;
+        ScoreReply *r = &a.reply;
+        uint64_t records[SCORENET_MAX_RANGE];
+
+        memset(&a, 0, sizeof(Answer));
+        a.fd = p->fd;
+        a.client = p->client;
+        r->status = STATUS_OK;
+        if (p->request.type == REQUEST_SUBMIT && appended) {
+            r->record = record++;
+            if (ranked) {
+                r->rank = leaderboard_position(s->leaderboard, r->record);
+            }
+            else {
+                r->status = STATUS_UNRANKED;
+            }
+            r->commit_time = committed - p->received;
+            if (s->submissions < SCORED_MAX_SAMPLES) {
+                s->samples[s->submissions] = r->commit_time;
+            }
+            s->submissions++;
+        }
+        else if (p->request.type == REQUEST_SUBMIT) {
+            r->status = STATUS_FAILED;
+        }
+        else if (p->request.type == REQUEST_RANGE) {
+            int count = p->request.count < SCORENET_MAX_RANGE ? p->request.count : SCORENET_MAX_RANGE;
+            r->rank = p->request.first;
+            r->count = leaderboard_range(s->leaderboard, p->request.first, count, records);
+            for (int k = 0; k < (int) r->count; k++) {
+                r->items[k] = *scores_get(s->scores, records[k]);
+            }
+        }
+        else {
+            r->status = STATUS_BAD_REQUEST;
+        }
+        r->total = s->scores->header.count;
+        if (!queue_push(s->replies, &a)) {
+            /* the connection thread never waits on the writer, once woken
+             * it empties the queue */
+            write(s->replies_ready, &one, sizeof(one));
+            while (!queue_push(s->replies, &a)) {
+                sched_yield();
+            }
+        }
+    }
+    write(s->replies_ready, &one, sizeof(one));
+}
+
+
+int compare_uint32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+
+uint64_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+void print_report(Server *s) {
+    uint64_t n = s->submissions < SCORED_MAX_SAMPLES ? s->submissions : SCORED_MAX_SAMPLES;
+    qsort(s->samples, n, sizeof(uint32_t), compare_uint32);
+    fprintf(
+        stderr,
+        "%llu submissions in %llu commits (%.1f per commit), commit time p50 %u us, "
+        "p99 %u us, max %u us\n",
+        (unsigned long long) s->submissions,
+        (unsigned long long) s->commits,
+        s->commits > 0 ? (double) s->submissions / s->commits : 0.0,
+        n > 0 ? s->samples[(n - 1) / 2] : 0,
+        n > 0 ? s->samples[(n - 1) * 99 / 100] : 0,
+        n > 0 ? s->samples[n - 1] : 0
+    );
+}
+
+
+/* hand the replies of the writer to the connections still open, then send
+ * each of them what it got in one go; connections whose socket was full
+ * are left for epoll to report them writable */
+void send_replies(Server *s, int epoll) {
+    int touched[SCORED_MAX_CLIENTS];
+    int ntouched = 0;
+    Answer a;
+    uint64_t count;
+
+    read(s->replies_ready, &count, sizeof(count));
+    while (queue_pop(s->replies, &a)) {
+        Client *c = &s->clients[a.fd];
+        if (c->id != a.client || !client_queue(s, epoll, a.fd, &a.reply)) {
+            continue;
+        }
+        if (!c->touched) {
+            c->touched = true;
+            touched[ntouched++] = a.fd;
+        }
+    }
+    for (int i = 0; i < ntouched; i++) {
+        Client *c = &s->clients[touched[i]];
+        c->touched = false;
+        if (c->id != 0 && !c->writing) {
+            client_flush(s, epoll, touched[i]);
+        }
+    }
+    resume_clients(s, epoll);
+}
+
+
+/* the writer took requests since the clients were paused, queue what they
+ * held and read them again, those that still do not fit stay paused */
+void resume_clients(Server *s, int epoll) {
+    int queued = 0, left = 0;
+
+    for (int i = 0; i < s->npaused; i++) {
+        int fd = s->paused[i];
+        Client *c = &s->clients[fd];
+        if (!c->paused) {
+            continue;
+        }
+        if (!client_submit(s, fd)) {
+            s->paused[left++] = fd;
+            continue;
+        }
+        c->paused = false;
+        client_watch(s, epoll, fd);
+        queued++;
+    }
+    s->npaused = left;
+    if (queued > 0) {
+        uint64_t one = 1;
+        write(s->requests_ready, &one, sizeof(one));
+    }
+}
+
+
+void usage(char *name) {
+    fprintf(stderr, "usage: %s [-f scores.db] [-s socket]\n", name);
+}
+
+
+void *writer_loop(void *arg) {
+    Server *s = arg;
+    uint64_t count;
+
+    for (;;) {
+        bool stop = atomic_load(&s->stop);
+        for (;;) {
+            int n = 0;
+            while (n < SCORED_MAX_BATCH && queue_pop(s->requests, &s->batch[n])) {
+                n++;
+            }
+            if (n == 0) {
+                break;
+            }
+            commit_batch(s, n);
+        }
+        if (stop) {
+            uint64_t one = 1;
+            atomic_store(&s->stopped, true);
+            write(s->replies_ready, &one, sizeof(one));
+            return NULL;
+        }
+        read(s->requests_ready, &count, sizeof(count));
+    }
+}
+
+
+int main(int argc, char *argv[]) {
+    char *path = "scores.db";
+    char *socket_path = SCORENET_SOCKET;
+    char index_path[4096];
+    struct sockaddr_un address;
+    struct epoll_event event, events[SCORED_MAX_EVENTS];
+    sigset_t signals;
+    pthread_t writer;
+    bool writer_started = false;
+    bool quit = false;
+    uint64_t one = 1;
+    int listener = -1, epoll = -1, signals_fd = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:s:h")) != -1) {
+        switch (opt) {
+            case 'f':
+                path = optarg;
+                break;
+            case 's':
+                socket_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    Server *s = calloc(1, sizeof(Server));
+    check_mem(s);
+    s->requests_ready = s->replies_ready = -1;
+    s->samples = malloc(SCORED_MAX_SAMPLES * sizeof(uint32_t));
+    check_mem(s->samples);
+    s->scores = scores_open(path);
+    check(s->scores != NULL, "Failed to open %s", path);
+    snprintf(index_path, sizeof(index_path), "%s.idx", path);
+    s->leaderboard = leaderboard_open(s->scores, index_path);
+    check(s->leaderboard != NULL, "Failed to open %s", index_path);
+    s->requests = queue_new(SCORED_QUEUE_LENGTH, sizeof(Pending));
+    check(s->requests != NULL, "Failed to create request queue");
+    s->replies = queue_new(SCORED_QUEUE_LENGTH, sizeof(Answer));
+    check(s->replies != NULL, "Failed to create reply queue");
+    s->requests_ready = eventfd(0, EFD_CLOEXEC);
+    s->replies_ready = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    check(s->requests_ready >= 0 && s->replies_ready >= 0, "Failed to create eventfd");
+
+    /* the store is locked, so a socket left there is from a dead daemon */
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    check(listener >= 0, "Failed to create socket");
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+    unlink(socket_path);
+    check(bind(listener, (struct sockaddr *) &address, sizeof(address)) == 0, "Failed to bind %s", socket_path);
+    check(listen(listener, SOMAXCONN) == 0, "Failed to listen on %s", socket_path);
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signals_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+    check(signals_fd >= 0, "Failed to create signalfd");
+
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    check(epoll >= 0, "Failed to create epoll");
+    event.events = EPOLLIN;
+    event.data.fd = listener;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+    event.data.fd = s->replies_ready;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, s->replies_ready, &event);
+    event.data.fd = signals_fd;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, signals_fd, &event);
+
+    check(pthread_create(&writer, NULL, writer_loop, s) == 0, "Failed to start writer");
+    writer_started = true;
+    fprintf(stderr, "Serving %s on %s\n", path, socket_path);
+
+    while (!quit) {
+        int n = epoll_wait(epoll, events, SCORED_MAX_EVENTS, -1);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == signals_fd) {
+                quit = true;
+            }
+            else if (fd == s->replies_ready) {
+                send_replies(s, epoll);
+            }
+            else if (fd == listener) {
+                int client = accept(listener, NULL, NULL);
+                if (client < 0) {
+                    continue;
+                }
+                if (client >= SCORED_MAX_CLIENTS) {
+                    log_warn("Too many clients, connection refused");
+                    close(client);
+                    continue;
+                }
+                fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+                s->clients[client].id = ++s->next_id;
+                s->clients[client].have = 0;
+                event.data.fd = client;
+                epoll_ctl(epoll, EPOLL_CTL_ADD, client, &event);
+            }
+            else if (s->clients[fd].id != 0) {
+                if (events[i].events & EPOLLOUT) {
+                    client_flush(s, epoll, fd);
+                }
+                if (s->clients[fd].id != 0 && events[i].events & ~EPOLLOUT) {
+                    client_read(s, epoll, fd);
+                }
+            }
+        }
+    }
+
+    /* let the writer commit what it has, then stop it; its replies are taken
+     * meanwhile so that it never waits on a full queue */
+    atomic_store(&s->stop, true);
+    write(s->requests_ready, &one, sizeof(one));
+    while (!atomic_load(&s->stopped)) {
+        struct pollfd ready = {s->replies_ready, POLLIN, 0};
+        poll(&ready, 1, -1);
+        send_replies(s, epoll);
+    }
+    pthread_join(writer, NULL);
+    send_replies(s, epoll);
+    print_report(s);
+    unlink(socket_path);
+    close(listener);
+    close(epoll);
+    close(signals_fd);
+    leaderboard_close(s->leaderboard);
+    scores_close(s->scores);
+    queue_free(s->requests);
+    queue_free(s->replies);
+    for (int i = 0; i < SCORED_MAX_CLIENTS; i++) {
+        free(s->clients[i].out);
+    }
+    free(s->samples);
+    free(s);
+    return 0;
+
+    error:
+        if (writer_started) {
+            atomic_store(&s->stop, true);
+            write(s->requests_ready, &one, sizeof(one));
+            pthread_join(writer, NULL);
+        }
+        if (listener >= 0) {
+            close(listener);
+        }
+        if (s != NULL) {
+            leaderboard_close(s->leaderboard);
+            scores_close(s->scores);
+            queue_free(s->requests);
+            queue_free(s->replies);
+            free(s->samples);
+            free(s);
+        }
+        return 1;
+}
@@ -0,0 +1,198 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "scorenet.h"
+
+
+#define DEFAULT_CONNECTIONS 8
+#define DEFAULT_SUBMISSIONS 10000
+#define DEFAULT_WINDOW 4
+#define MAX_WINDOW 256
+
+
+typedef struct load {
+    const char *socket_path;
+    int id;
+    int submissions;
+    int window;  /* submissions sent ahead of their replies */
+    uint32_t *round_trips;  /* in microseconds, one per submission */
+    uint32_t *commit_times;
+    int done;
+} Load;
+
+
+int compare_uint32(const void *, const void *);
+uint64_t now_us();
+void *run_connection(void *);
+uint32_t percentile(uint32_t *, int, double);
+void usage(char *);
+
+
+int compare_uint32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+
+uint64_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+/* one connection submitting as fast as the daemon answers, with up to
+ * window submissions in flight */
+void *run_connection(void *arg) {
+    Load *l = arg;
+    uint64_t sent_at[MAX_WINDOW];
+    ScoreRequest request;
+    ScoreReply reply;
+    int sent = 0;
+
+    int fd = scorenet_connect(l->socket_path);
+    check(fd >= 0, "Failed to connect to %s", l->socket_path);
+    memset(&request, 0, sizeof(ScoreRequest));
+    request.type = REQUEST_SUBMIT;
+    snprintf(request.item.name, SCORES_NAME_LENGTH, "load%d", l->id);
+
+    while (l->done < l->submissions) {
+        while (sent < l->submissions && sent - l->done < l->window) {
+            request.item.score = (uint32_t) (sent * 2654435761u) % 1000000;
+            request.item.time = time(NULL);
+            sent_at[sent % l->window] = now_us();
+            check(scorenet_send(fd, &request), "Failed to submit");
+            sent++;
+        }
+        check(scorenet_receive(fd, &reply), "Failed to get reply");
+        check(reply.status == STATUS_OK || reply.status == STATUS_UNRANKED, "Submission failed");
+        l->round_trips[l->done] = now_us() - sent_at[l->done % l->window];
+        l->commit_times[l->done] = reply.commit_time;
+        l->done++;
+    }
+    close(fd);
+    return NULL;
+
+    error:
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+}
+
+
+/* of n sorted values */
+uint32_t percentile(uint32_t *values, int n, double q) {
+    return n > 0 ? values[(int) ((n - 1) * q)] : 0;
+}
+
+
+void usage(char *name) {
+    fprintf(
+        stderr,
+        "usage: %s [-c connections] [-n submissions per connection] [-w window] [-s socket]\n",
+        name
+    );
+}
+
+
+int main(int argc, char *argv[]) {
+    int nconnections = DEFAULT_CONNECTIONS;
+    int submissions = DEFAULT_SUBMISSIONS;
+    int window = DEFAULT_WINDOW;
+    char *socket_path = SCORENET_SOCKET;
+    Load *loads = NULL;
+    pthread_t *threads = NULL;
+    uint32_t *round_trips = NULL, *commit_times = NULL;
+    struct timespec start, end;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:n:w:s:h")) != -1) {
+        switch (opt) {
+            case 'c':
+                nconnections = atoi(optarg);
+                break;
+            case 'n':
+                submissions = atoi(optarg);
+                break;
+            case 'w':
+                window = atoi(optarg);
+                break;
+            case 's':
+                socket_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    check(nconnections > 0 && submissions > 0, "Connections and submissions must be positive");
+    check(window > 0 && window <= MAX_WINDOW, "Window must be between 1 and %d", MAX_WINDOW);
+
+    loads = calloc(nconnections, sizeof(Load));
+    threads = calloc(nconnections, sizeof(pthread_t));
+    round_trips = malloc((size_t) nconnections * submissions * sizeof(uint32_t));
+    commit_times = malloc((size_t) nconnections * submissions * sizeof(uint32_t));
+    check_mem(loads && threads && round_trips && commit_times);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < nconnections; i++) {
+        Load *l = &loads[i];
+        l->socket_path = socket_path;
+        l->id = i;
+        l->submissions = submissions;
+        l->window = window;
+        l->round_trips = round_trips + (size_t) i * submissions;
+        l->commit_times = commit_times + (size_t) i * submissions;
+        check(pthread_create(&threads[i], NULL, run_connection, l) == 0, "Failed to start thread");
+    }
+    for (int i = 0; i < nconnections; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* pack the samples of connections that stopped early */
+    int n = 0;
+    for (int i = 0; i < nconnections; i++) {
+        memmove(round_trips + n, loads[i].round_trips, loads[i].done * sizeof(uint32_t));
+        memmove(commit_times + n, loads[i].commit_times, loads[i].done * sizeof(uint32_t));
+        n += loads[i].done;
+    }
+    qsort(round_trips, n, sizeof(uint32_t), compare_uint32);
+    qsort(commit_times, n, sizeof(uint32_t), compare_uint32);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf(
+        "%d submissions on %d connections in %.3f s: %.0f submissions/s\n"
+        "round trip p50 %u us, p99 %u us; commit p50 %u us, p99 %u us, max %u us\n",
+        n,
+        nconnections,
+        seconds,
+        n / seconds,
+        percentile(round_trips, n, 0.50),
+        percentile(round_trips, n, 0.99),
+        percentile(commit_times, n, 0.50),
+        percentile(commit_times, n, 0.99),
+        n > 0 ? commit_times[n - 1] : 0
+    );
+    free(loads);
+    free(threads);
+    free(round_trips);
+    free(commit_times);
+    return n == nconnections * submissions ? 0 : 1;
+
+    error:
+        free(loads);
+        free(threads);
+        free(round_trips);
+        free(commit_times);
+        return 1;
+}
@@ -0,0 +1,83 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "scorenet.h"
+
+
+static bool read_full(int, void *, size_t);
+static bool write_full(int, const void *, size_t);
+
+
+bool scorenet_call(int fd, const ScoreRequest *request, ScoreReply *reply) {
+    return scorenet_send(fd, request) && scorenet_receive(fd, reply);
+}
+
+
+/* connect to the score daemon, returns -1 if it is not running */
+int scorenet_connect(const char *path) {
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    check(fd >= 0, "Failed to create socket");
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+
+    error:
+        return -1;
+}
+
+
+bool scorenet_receive(int fd, ScoreReply *reply) {
+    return read_full(fd, reply, sizeof(ScoreReply));
+}
+
+
+bool scorenet_send(int fd, const ScoreRequest *request) {
+    return write_full(fd, request, sizeof(ScoreRequest));
+}
+
+
+static bool read_full(int fd, void *data, size_t length) {
+    uint8_t *p = data;
+    while (length > 0) {
+        ssize_t n = read(fd, p, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+
+static bool write_full(int fd, const void *data, size_t length) {
+    const uint8_t *p = data;
+    while (length > 0) {
+        ssize_t n = send(fd, p, length, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        length -= n;
+    }
+    return true;
+}
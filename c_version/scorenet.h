@@ -0,0 +1,54 @@
+#ifndef __scorenet_h__
+#define __scorenet_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "scores.h"
+
+
+#define SCORENET_SOCKET "scores.sock"  /* next to the score file by default */
+#define SCORENET_MAX_RANGE 16  /* scores one range request can return */
+
+
+enum SCORENET_REQUESTS {
+    REQUEST_SUBMIT,  /* add item to the store */
+    REQUEST_RANGE  /* get the scores of ranks first to first + count - 1 */
+};
+
+enum SCORENET_STATUS {
+    STATUS_OK,
+    STATUS_FAILED,  /* the daemon could not do it, e.g. a write failed */
+    STATUS_BAD_REQUEST,
+    STATUS_UNRANKED  /* the submission was saved but could not be ranked, rank is not set */
+};
+
+
+/* requests and replies have a fixed size and are read and written as is,
+ * both ends run on the same machine */
+typedef struct score_request {
+    uint32_t type;  /* one of SCORENET_REQUESTS */
+    uint32_t count;
+    uint64_t first;
+    ScoreItem item;
+} ScoreRequest;
+
+typedef struct score_reply {
+    uint32_t status;  /* one of SCORENET_STATUS */
+    uint32_t count;  /* scores in items */
+    uint64_t record;  /* where a submitted score went in the store */
+    uint64_t rank;  /* of a submitted score, or of items[0] */
+    uint64_t total;  /* scores in the store */
+    uint32_t commit_time;  /* from the daemon getting a submission to the
+                            * commit holding it, in microseconds */
+    uint32_t padding;
+    ScoreItem items[SCORENET_MAX_RANGE];
+} ScoreReply;
+
+
+bool scorenet_call(int, const ScoreRequest *, ScoreReply *);
+int scorenet_connect(const char *);
+bool scorenet_receive(int, ScoreReply *);
+bool scorenet_send(int, const ScoreRequest *);
+
+#endif
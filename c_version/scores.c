@@ -1,143 +1,190 @@
-#include <errno.h>
 #include <fcntl.h>
+#include <stdbool.h>
 #include <stdint.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "debug.h"
+#include "scores.h"
 
-typedef struct {
-    char name[9];
-    uint32_t score;
-} ScoreItem;
 
+static uint32_t checksum(const ScoresHeader *);
+static bool grow(Scores *, uint64_t);
+static bool header_valid(const ScoresHeader *);
+static bool map(Scores *, uint64_t);
+static bool write_header(Scores *, const ScoresHeader *);
 
-typedef struct {
-    char *buffer;
-    size_t length;
-} InputBuffer;
 
+/* add n records in one commit: they are written and synced past the end of
+ * the store first, then a new header takes them in */
+bool scores_append(Scores *s, const ScoreItem *items, int n) {
+    ScoresHeader header = s->header;
+    uint64_t offset = SCORES_DATA_OFFSET + s->header.count * sizeof(ScoreItem);
+    size_t length = (size_t) n * sizeof(ScoreItem);
 
-#define size_of_attr(Struct, Attr) sizeof(((Struct*)0)->Attr)
-#define SCORE_ARRAY_LENGTH 10
-#define SCORES_LENGTH_SIZE sizeof(uint8_t)
-#define SCORES_LENGTH_OFFSET 0
-#define SCORES_ARRAY_OFFSET SCORES_LENGTH_SIZE
+    check(grow(s, s->header.count + n), "Failed to grow score file");
+    check(pwrite(s->fd, items, length, offset) == (ssize_t) length, "Failed to write scores");
+    check(fdatasync(s->fd) == 0, "Failed to sync scores");
+    header.sequence++;
+    header.count += n;
+    check(write_header(s, &header), "Failed to commit scores");
+    s->header = header;
+    return true;
 
-#define NAME_SIZE size_of_attr(ScoreItem, name)
-#define SCORE_SIZE size_of_attr(ScoreItem, score)
-#define NAME_OFFSET 0
-#define SCORE_OFFSET NAME_OFFSET + NAME_SIZE
-
-
-InputBuffer *buffer_new();
-void close_all();
-void deserialize_score(void *, ScoreItem *);
+    error:
+        return false;
+}
 
 
-ScoreItem score_array[SCORE_ARRAY_LENGTH];
-int fd;
+void scores_close(Scores *s) {
+    if (s == NULL) {
+        return;
+    }
+    if (s->map != NULL) {
+        munmap(s->map, s->size);
+    }
+    if (s->fd >= 0) {
+        close(s->fd);
+    }
+    free(s);
+}
 
 
-InputBuffer *buffer_new() {
-    InputBuffer *buf = (InputBuffer*) malloc(sizeof(InputBuffer));
-    buf->buffer = NULL;
-    buf->length = 0;
-    return buf;
+/* record i of the store, valid until the next append */
+const ScoreItem *scores_get(const Scores *s, uint64_t i) {
+    if (i >= s->header.count) {
+        return NULL;
+    }
+    return (const ScoreItem *) (s->map + SCORES_DATA_OFFSET) + i;
 }
 
 
-void close_all() {
-    close(fd);
-}
+/* open a score file or create it, only the two header copies are read so
+ * this takes the same time whatever the number of records; one process at
+ * a time can have it open */
+Scores *scores_open(const char *path) {
+    struct stat st;
+    Scores *s = calloc(1, sizeof(Scores));
+    check_mem(s);
+
+    s->fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    check(s->fd >= 0, "Failed to open %s", path);
+    check(flock(s->fd, LOCK_EX | LOCK_NB) == 0, "%s is in use by another process", path);
+    check(fstat(s->fd, &st) == 0, "Failed to get the size of %s", path);
+
+    if (st.st_size == 0) {
+        ScoresHeader header;
+        memset(&header, 0, sizeof(ScoresHeader));
+        memcpy(header.magic, SCORES_MAGIC, sizeof(header.magic));
+        header.version = SCORES_VERSION;
+        header.record_size = sizeof(ScoreItem);
+        uint64_t size = SCORES_DATA_OFFSET + SCORES_MIN_CAPACITY * sizeof(ScoreItem);
+        check(ftruncate(s->fd, size) == 0, "Failed to size %s", path);
+        check(map(s, size), "Failed to map %s", path);
+        /* slot 1 gets sequence 1 so that the first commit goes to slot 0 */
+        check(write_header(s, &header), "Failed to write %s", path);
+        header.sequence++;
+        check(write_header(s, &header), "Failed to write %s", path);
+        s->header = header;
+        return s;
+    }
 
+    check(st.st_size >= SCORES_DATA_OFFSET, "%s is not a score file", path);
+    check(map(s, st.st_size), "Failed to map %s", path);
+    const ScoresHeader *first = (const ScoresHeader *) s->map;
+    const ScoresHeader *second = (const ScoresHeader *) (s->map + SCORES_HEADER_SLOT);
+    bool first_valid = header_valid(first);
+    bool second_valid = header_valid(second);
+    check(first_valid || second_valid, "%s is not a score file or is damaged", path);
+    if (first_valid && (!second_valid || first->sequence > second->sequence)) {
+        s->header = *first;
+    }
+    else {
+        s->header = *second;
+    }
+    check(
+        SCORES_DATA_OFFSET + s->header.count * sizeof(ScoreItem) <= s->size,
+        "%s is truncated",
+        path
+    );
+    return s;
 
-void deserialize_score(void *source, ScoreItem *destination) {
-    memcpy(&(destination->name), source + NAME_OFFSET, NAME_SIZE);
-    memcpy(&(destination->score), source + SCORE_OFFSET, SCORE_SIZE);
+    error:
+        scores_close(s);
+        return NULL;
 }
 
 
-int main(int argc, char *argv[]) {
-    fd = open(
-        "scores.db",
-        O_CREAT | O_RDWR,  /* create file if not exists, for reading and writing */
-        S_IRUSR | S_IWUSR  /* give file owner read and write permissions */
-    );
+/* FNV-1a */
+static uint32_t checksum(const ScoresHeader *h) {
+    ScoresHeader copy = *h;
+    const uint8_t *bytes = (const uint8_t *) &copy;
+    uint32_t hash = 2166136261u;
+
+    copy.checksum = 0;
+    for (size_t i = 0; i < sizeof(ScoresHeader); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
 
-    printf("NAME_SIZE = %ld\n", NAME_SIZE);
-    printf("SCORE_SIZE = %ld\n", SCORE_SIZE);
 
-    uint32_t n_scores = 0;
-    ssize_t bytes_read = read(fd, &n_scores, SCORES_LENGTH_SIZE);
-    printf("Read %ld bytes\n", bytes_read);
-    if (bytes_read < 0) {
-        printf("Error reading file: %d\n", errno);
-        close_all();
-        exit(EXIT_FAILURE);
+/* make room in the file for count records, doubling it as needed */
+static bool grow(Scores *s, uint64_t count) {
+    uint64_t capacity = (s->size - SCORES_DATA_OFFSET) / sizeof(ScoreItem);
+    if (count <= capacity) {
+        return true;
     }
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    uint64_t size = SCORES_DATA_OFFSET + capacity * sizeof(ScoreItem);
+    check(ftruncate(s->fd, size) == 0, "Failed to grow score file");
+    munmap(s->map, s->size);
+    s->map = NULL;
+    return map(s, size);
+
+    error:
+        return false;
+}
 
-    printf("n_scores: %d\n", n_scores);
 
-    printf("size of ScoreItem: %ld\n", sizeof(ScoreItem));
-    printf("size of score_array: %ld\n", sizeof(score_array));
+static bool header_valid(const ScoresHeader *h) {
+    return memcmp(h->magic, SCORES_MAGIC, sizeof(h->magic)) == 0
+        && h->version == SCORES_VERSION
+        && h->record_size == sizeof(ScoreItem)
+        && h->checksum == checksum(h);
+}
 
-    /*
-    printf("pointer to score_array[0]: %p\n", &score_array[0]);
-    printf("pointer to score_array[1]: %p\n", &score_array[1]);
 
-    printf("pointer to score_array[0].name: %p\n", &score_array[0].name);
-    printf("pointer to score_array[1].name: %p\n", &score_array[1].name);
-    */
+static bool map(Scores *s, uint64_t size) {
+    void *m = mmap(NULL, size, PROT_READ, MAP_SHARED, s->fd, 0);
+    check(m != MAP_FAILED, "Failed to map score file");
+    s->map = m;
+    s->size = size;
+    return true;
 
-    if (bytes_read > 0) {
-        for (int i = 0; i < n_scores; i++) {
-            bytes_read = read(fd, &score_array[i], sizeof(ScoreItem));
-            if (bytes_read <= 0) {
-                printf("Error reading file: %d\n", errno);
-                close_all();
-                exit(EXIT_FAILURE);
-            }
-        }
-    }
+    error:
+        return false;
+}
 
-    for (int i = 0; i < n_scores; i++) {
-        printf("score_array[%d] = {%s, %d}\n", i, score_array[i].name, score_array[i].score);
-    }
 
-    /*
-    char *name1 = "alice";
-    uint32_t score1 = 12345;
-    memcpy((score_array[0]).name, name1, NAME_SIZE);
-    memcpy(&((score_array[0]).score), &score1, SCORE_SIZE);
-
-    char *name2 = "bob";
-    uint32_t score2 = 23456;
-    memcpy((score_array[1]).name, name2, NAME_SIZE);
-    memcpy(&((score_array[1]).score), &score2, SCORE_SIZE);
-
-    char *name3 = "charlie";
-    uint32_t score3 = 34567;
-    memcpy((score_array[2]).name, name3, NAME_SIZE);
-    memcpy(&((score_array[2]).score), &score3, SCORE_SIZE);
-
-    n_scores = 3;
-    lseek(fd, 0, SEEK_SET);
-    ssize_t bytes_written = write(fd, &n_scores, SCORES_LENGTH_SIZE);
-
-    printf("bytes written: %ld\n", bytes_written);
-    if (bytes_written <= 0) {
-        printf("Error writing file: %d\n", errno);
-        close_all();
-        exit(EXIT_FAILURE);
-    }
-    */
-    for (int i = 0; i < 3; i++) {
-        write(fd, &score_array[i], sizeof(ScoreItem));
-    }
+/* write a header to the slot its sequence number picks and sync it */
+static bool write_header(Scores *s, const ScoresHeader *h) {
+    uint8_t slot[SCORES_HEADER_SLOT] = {0};
+    ScoresHeader *header = (ScoresHeader *) slot;
 
-    close_all();
+    *header = *h;
+    header->checksum = checksum(header);
+    off_t offset = (h->sequence % 2) * SCORES_HEADER_SLOT;
+    check(pwrite(s->fd, slot, SCORES_HEADER_SLOT, offset) == SCORES_HEADER_SLOT, "Failed to write header");
+    check(fdatasync(s->fd) == 0, "Failed to sync header");
+    return true;
 
-    return 0;
-};
+    error:
+        return false;
+}
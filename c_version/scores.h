@@ -0,0 +1,50 @@
+#ifndef __scores_h__
+#define __scores_h__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define SCORES_MAGIC "TSCO"
+#define SCORES_VERSION 1
+#define SCORES_NAME_LENGTH 20
+#define SCORES_HEADER_SLOT 64  /* bytes taken by each copy of the header */
+#define SCORES_DATA_OFFSET (2 * SCORES_HEADER_SLOT)
+#define SCORES_MIN_CAPACITY 1024  /* records, the file doubles from there */
+
+
+/* one score as stored in the file */
+typedef struct score_item {
+    char name[SCORES_NAME_LENGTH];  /* null-terminated unless it fills the array */
+    uint32_t score;
+    uint64_t time;  /* when the game ended, in seconds since the epoch */
+} ScoreItem;
+
+/* the file starts with two copies of the header, a commit writes the older
+ * one so that a crash half way through it leaves the other intact; records
+ * past count are not part of the store even if the file has them */
+typedef struct scores_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t checksum;  /* of the header with this field set to 0 */
+    uint64_t sequence;  /* incremented on each commit, the higher copy wins */
+    uint64_t count;  /* committed records */
+} ScoresHeader;
+
+/* a score file mapped in memory, records are read in place and appended
+ * with write calls */
+typedef struct scores {
+    int fd;
+    uint8_t *map;
+    uint64_t size;  /* bytes of the file and of the mapping */
+    ScoresHeader header;  /* latest commit */
+} Scores;
+
+
+bool scores_append(Scores *, const ScoreItem *, int);
+void scores_close(Scores *);
+const ScoreItem *scores_get(const Scores *, uint64_t);
+Scores *scores_open(const char *);
+
+#endif
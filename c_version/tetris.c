@@ -1,6 +1,5 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
-#include <SDL2/SDL_mixer.h>
 #include <SDL2/SDL_ttf.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -8,14 +7,30 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "audio.h"
+#include "bot.h"
 #include "debug.h"
+#include "engine.h"
+#include "input.h"
+#include "leaderboard.h"
+#include "logic.h"
+#include "profiler.h"
+#include "replay.h"
+#include "scorenet.h"
+#include "scores.h"
+#include "text.h"
+#include "threadpool.h"
+#ifdef EMBED_ASSETS
+#include "assets.h"
+#endif
 
 
 #define SCREEN_FPS 10
 #define SCREEN_TICKS_PER_FRAME (1000 / SCREEN_FPS)
-#define PLAYFIELD_CELL_WIDTH 16
-#define PLAYFIELD_CELL_HEIGHT 24
+#define FALLBACK_FPS 60  /* frame cap of the game window when there is no vsync */
+#define LOGIC_MAX_STEPS (LOGIC_HZ / 10)  /* catch up at most 100 ms per frame */
 #define CELL_WIDTH 16
 #define PLAYFIELD_WIDTH (PLAYFIELD_CELL_WIDTH * CELL_WIDTH)
 #define PLAYFIELD_HEIGHT (PLAYFIELD_CELL_HEIGHT * CELL_WIDTH)
@@ -30,13 +45,10 @@
 #define INFOFIELD_POSITION_X (SCREEN_WIDTH / 2 + INFOFIELD_WIDTH / 4) 
 #define INFOFIELD_POSITION_Y (SCREEN_HEIGHT / 2 - INFOFIELD_HEIGHT / 2)
 #define FONTSIZE 16
-#define PIECE_VELOCITY 1
-#define PIECE_MATRIX_WIDTH 4
-#define PIECE_MATRIX_HEIGHT 4
-#define NPIECES 7
-#define FULL_ROWS_PER_LEVEL 8
 #define PLAYER_NAME_LENGTH 10
 #define NUMBER_HIGH_SCORES 10
+#define HIGH_SCORES_AROUND 2  /* players shown on each side of the current game */
+#define OVERLAY_REFRESH_TICKS 1000
 
 
 typedef struct texture {
@@ -45,25 +57,45 @@ typedef struct texture {
     int height;
 } Texture;
 
-typedef struct piece {
-    int shape; /* shape name */
-    int posx;  /* x-position of top left corner of matrix */
-    int posy;  /* y-position of top left corner of matrix */
-    int velx;  /* velocity along the x-axis */
-    int vely;  /* velocity along the y-axis */
-    int matrix[PIECE_MATRIX_HEIGHT][PIECE_MATRIX_WIDTH];  /* shape representation */
-    bool landed;  /* if piece lands on bottom of playfield or another piece */
-} Piece;
-
 typedef struct timer {
     uint32_t start_ticks;
     bool started;
 } Timer;
 
-typedef struct score {
-    char name[PLAYER_NAME_LENGTH];
-    uint32_t score;
-} Score;
+/* the game logic advances in fixed steps of 1 / LOGIC_HZ second, whatever
+ * the frame rate, time not simulated yet carries over to the next frame */
+typedef struct ticker {
+    uint64_t last;  /* performance counter when the ticker last advanced */
+    uint64_t lag;  /* counter ticks not simulated yet */
+    uint64_t period;  /* counter ticks per step */
+    Logic logic;  /* in microseconds of SDL_GetTicks */
+} Ticker;
+
+enum MEDIA_KINDS {MEDIA_IMAGE, MEDIA_SOUND, MEDIA_FONT};
+
+
+typedef struct options {
+    uint64_t seed;
+    int randomizer;
+    char *profile_path;  /* where to write frame timings, NULL if not profiling */
+    uint32_t das;  /* auto shift timings, in microseconds */
+    uint32_t arr;
+    bool bot;  /* the computer plays */
+    bool headless;  /* no window, the bot plays as fast as it can */
+    int bot_depth;
+    int bot_width;
+    int max_pieces;  /* headless games stop after this many pieces, 0 for no limit */
+    char *record_path;  /* where to record the game, NULL if not recording */
+    int audio_samples;  /* frames per audio buffer */
+} Options;
+
+/* an asset to decode on a worker thread, result is where it goes */
+typedef struct media_job {
+    char *path;
+    int kind;  /* one of MEDIA_KINDS */
+    void **result;
+    char error[256];  /* why it failed, SDL keeps the error of each thread apart */
+} MediaJob;
 
 
 char *CELL_TILES = "cells.png";
@@ -72,240 +104,308 @@ char *CLEAR_ROW_TWO = "sounds/clear_two.wav";
 char *CLEAR_ROW_THREE = "sounds/clear_three.wav";
 char *CLEAR_ROW_FOUR = "sounds/clear_four.wav";
 char *PIECE_LANDED = "sounds/landed.wav";
-char *HIGH_SCORES_FILE = "highscores.txt";
-int POINTS[5] = {0, 50, 150, 350, 1000};
-enum SHAPES {I = 1, J, L, O, S, T, Z};
+char *FONT_FILE = "fonts/OpenSans-Regular.ttf";
+char *HIGH_SCORES_FILE = "scores.db";
+char *HIGH_SCORES_INDEX = "scores.db.idx";
+char *HIGH_SCORES_SOCKET = SCORENET_SOCKET;
 
 SDL_Window *gWindow = NULL;
 SDL_Renderer *gRenderer = NULL;
 SDL_Window *gInputWindow = NULL;
 SDL_Renderer *gInputRenderer = NULL;
 Texture gCellTexture = {NULL, 0, 0};
-int gPlayfield[PLAYFIELD_CELL_HEIGHT][PLAYFIELD_CELL_WIDTH];
-Mix_Chunk *gPieceLanded = NULL;
-Mix_Chunk *gClearRowOne = NULL;
-Mix_Chunk *gClearRowTwo = NULL;
-Mix_Chunk *gClearRowThree = NULL;
-Mix_Chunk *gClearRowFour = NULL;
+SDL_Texture *gPlayfieldTexture = NULL;  /* locked cells, kept between frames */
+uint8_t gPlayfieldDrawn[PLAYFIELD_CELL_HEIGHT][PLAYFIELD_CELL_WIDTH];  /* what it shows */
+uint32_t gPlayfieldGeneration;  /* board generation it was last brought up to date with */
+Game gGame;
+Input gInput;
+Pool *gPool = NULL;
+Bot *gBot = NULL;
+Recorder *gRecorder = NULL;
+Audio *gAudio = NULL;
+Sound *gPieceLanded = NULL;
+Sound *gClearRowOne = NULL;
+Sound *gClearRowTwo = NULL;
+Sound *gClearRowThree = NULL;
+Sound *gClearRowFour = NULL;
 TTF_Font *gFont = NULL;
-Texture gScoreInfoTexture = {NULL, 0, 0};
-Texture gLevelInfoTexture = {NULL, 0, 0};
-Texture gTotalRowsInfoTexture = {NULL, 0, 0};
+Atlas gAtlas = {NULL};
+Label gScoreLabel;
+Label gLevelLabel;
+Label gTotalRowsLabel;
 Texture gPlayerPromptTexture = {NULL, 0, 0};
 Texture gPlayerNameTexture = {NULL, 0, 0};
-Score gHighScores[NUMBER_HIGH_SCORES + 1]; /* include current game's score */
-int gNumberHighScores = 0;
-
-
-Piece piece_I = {
-    I,
-    0,
-    0,
-    0,
-    0,
-    {
-        {0, 1, 0, 0},
-        {0, 1, 0, 0},
-        {0, 1, 0, 0},
-        {0, 1, 0, 0}
-    }
-};
-
-Piece piece_J = {
-    J,
-    0,
-    0,
-    0,
-    0,
-    {
-        {0, 0, 1, 0},
-        {0, 0, 1, 0},
-        {0, 1, 1, 0},
-        {0, 0, 0, 0}
-    }
-};
-
-Piece piece_L = {
-    L,
-    0,
-    0,
-    0,
-    0,
-    {
-        {0, 1, 0, 0},
-        {0, 1, 0, 0},
-        {0, 1, 1, 0},
-        {0, 0, 0, 0}
-    }
-};
-
-Piece piece_O = {
-    O,
-    0,
-    0,
-    0,
-    0,
-    {
-        {0, 0, 0, 0},
-        {0, 1, 1, 0},
-        {0, 1, 1, 0},
-        {0, 0, 0, 0}
-    }
-};
-
-Piece piece_S = {
-    S,
-    0,
-    0,
-    0,
-    0,
-    {
-        {0, 0, 0, 0},
-        {0, 1, 1, 0},
-        {1, 1, 0, 0},
-        {0, 0, 0, 0}
-    }
-};
-
-Piece piece_T = {
-    T,
-    0,
-    0,
-    0,
-    0,
-    {
-        {0, 0, 0, 0},
-        {0, 1, 0, 0},
-        {1, 1, 1, 0},
-        {0, 0, 0, 0}
-    }
-};
-
-Piece piece_Z = {
-    Z,
-    0,
-    0,
-    0,
-    0,
-    {
-        {0, 0, 0, 0},
-        {1, 1, 0, 0},
-        {0, 1, 1, 0},
-        {0, 0, 0, 0}
-    }
-};
+Profiler gProfiler;
+Label gOverlayLabels[NPHASES + 3];  /* header line, one line per phase, latencies */
+bool gVsync = false;  /* presenting waits for the display refresh */
+bool gShowOverlay = false;
 
 
+void bot_drive(Ticker *);
+bool bot_headless(Options *);
+void bot_print_stats();
 void close_all();
-void highscores_read();
-void highscores_sort();
-void highscores_write();
-bool initialize();
-uint32_t level_timer_ticks(int);
+void highscores_print(char *, int, const Scores *, const Leaderboard *, uint64_t, int, uint64_t);
+bool highscores_update(const char *, int, char *);
+bool initialize(int);
 bool load_media();
-bool piece_collided(Piece *);
-void piece_handle_event(Piece *, SDL_Event);
-void piece_move(Piece *);
-bool piece_rotate_anticlock(Piece *);
-bool piece_rotate_clock(Piece *);
-Piece *piece_spawn();
-void playfield_add_piece(Piece *);
-int playfield_drop_full_rows();
-void playfield_print();
-void playfield_remove_piece(Piece *);
+void media_decode(void *, int64_t, int);
+SDL_RWops *media_open(const char *);
+double milliseconds(struct timespec *, struct timespec *);
+void overlay_render();
+void overlay_update();
+void input_handle_event(Ticker *, SDL_Event);
+bool input_send(Ticker *, int, bool, uint64_t);
+bool parse_args(int, char **, Options *);
+void piece_render(Piece *);
+void play_sounds(Game *);
+void playfield_invalidate();
 void playfield_render();
+bool playfield_texture_create();
+void playfield_update();
 bool start_input_window();
 void texture_destroy(Texture *);
-bool texture_from_file(Texture *, char *);
+bool texture_from_surface(Texture *, SDL_Surface *);
 bool texture_from_text(Texture *, char *, SDL_Color, SDL_Renderer *);
 void texture_render(Texture *, int, int, SDL_Rect *, SDL_Renderer *);
+int ticker_advance(Ticker *);
+void ticker_start(Ticker *);
 uint32_t timer_get_ticks(Timer *);
 void timer_start(Timer *);
 void timer_stop(Timer *);
-bool update_level(int, int);
-int update_score(int, int);
+
+
+/* when a new piece is up, queue the inputs the bot chose for it as key
+ * presses so that it moves through the same rules as a player's; the path
+ * is planned without gravity, so all of it is stamped with the end of the
+ * last logic step, the state it was planned from, and the next step plays
+ * it through before the piece can fall */
+void bot_drive(Ticker *t) {
+    static int planned = -1;  /* piece the inputs in the queue are for */
+    BotMove move;
+
+    if (planned == gGame.pieces_spawned || gInput.head != gInput.tail) {
+        return;
+    }
+    planned = gGame.pieces_spawned;
+    if (!bot_choose(gBot, &gGame, &move)) {
+        return;
+    }
+    uint64_t time = logic_time(&t->logic);
+    for (int i = 0; i < move.length; i++) {
+        if (!input_send(t, move.actions[i], true, time) || !input_send(t, move.actions[i], false, time)) {
+            break;
+        }
+    }
+}
+
+
+/* play a whole game without a window and print how it went */
+bool bot_headless(Options *opts) {
+    struct timespec start, end;
+
+    gPool = pool_new(0);
+    check(gPool != NULL, "Failed to start thread pool");
+    gBot = bot_new(gPool, opts->bot_depth, opts->bot_width);
+    check(gBot != NULL, "Failed to create bot");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (!gGame.over && (opts->max_pieces == 0 || gGame.pieces_spawned < opts->max_pieces)) {
+        if (!bot_play(gBot, &gGame)) {
+            gGame.over = true;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf(
+        "%d pieces, %d rows, level %d, score %d in %.3f s on %d threads: %.1f pieces/s\n",
+        gGame.pieces_spawned,
+        gGame.total_rows,
+        gGame.level,
+        gGame.score,
+        seconds,
+        pool_size(gPool),
+        gGame.pieces_spawned / seconds
+    );
+    bot_print_stats();
+    bot_free(gBot);
+    pool_free(gPool);
+    return true;
+
+    error:
+        bot_free(gBot);
+        pool_free(gPool);
+        return false;
+}
+
+
+void bot_print_stats() {
+    TTStats stats;
+    bot_stats(gBot, &stats);
+    printf(
+        "transposition table: %llu probes, %.1f%% hits, %llu stores, %llu evictions\n",
+        (unsigned long long) stats.probes,
+        stats.probes > 0 ? 100.0 * stats.hits / stats.probes : 0.0,
+        (unsigned long long) stats.stores,
+        (unsigned long long) stats.evictions
+    );
+}
 
 
 void close_all() {
+    bot_free(gBot);
+    gBot = NULL;
+    pool_free(gPool);
+    gPool = NULL;
+    replay_free(gRecorder);
+    gRecorder = NULL;
     texture_destroy(&gCellTexture);
+    if (gPlayfieldTexture != NULL) {
+        SDL_DestroyTexture(gPlayfieldTexture);
+        gPlayfieldTexture = NULL;
+    }
+    atlas_destroy(&gAtlas);
     TTF_CloseFont(gFont);
     gFont = NULL;
-    Mix_FreeChunk(gPieceLanded);
+    audio_close(gAudio);
+    gAudio = NULL;
+    audio_sound_free(gPieceLanded);
     gPieceLanded = NULL;
-    Mix_FreeChunk(gClearRowOne);
+    audio_sound_free(gClearRowOne);
     gClearRowOne = NULL;
-    Mix_FreeChunk(gClearRowTwo);
+    audio_sound_free(gClearRowTwo);
     gClearRowTwo = NULL;
-    Mix_FreeChunk(gClearRowThree);
+    audio_sound_free(gClearRowThree);
     gClearRowThree = NULL;
-    Mix_FreeChunk(gClearRowFour);
+    audio_sound_free(gClearRowFour);
     gClearRowFour = NULL;
     SDL_DestroyRenderer(gRenderer);
     gRenderer = NULL;
     SDL_DestroyWindow(gWindow);
     gWindow = NULL;
-    Mix_Quit();
     IMG_Quit();
     SDL_Quit();
 }
 
 
-void highscores_read() {
-    FILE *fp = fopen(HIGH_SCORES_FILE, "r");
-    check_mem(fp);
-    char *string = NULL;
-    size_t size = PLAYER_NAME_LENGTH + 1;  /* string is null-terminated */
-    size_t read;
-    char *token;
-    char delim[2] = ";";
-
-    for (int i = 1; (read = getline(&string, &size, fp)) != -1; i++) {
-        string[read - 1] = '\0';  /* discard newline character */
-        token = strtok(string, delim);
-        memcpy(gHighScores[i].name, token, PLAYER_NAME_LENGTH);
-        token = strtok(NULL, delim);
-        gHighScores[i].score = atoi(token);
-        gNumberHighScores++;
+/* append the lines of ranks first to first + n - 1 to text, from the score
+ * daemon if fd is connected to it or else from the files, the rank of the
+ * current game is marked */
+void highscores_print(
+    char *text,
+    int fd,
+    const Scores *scores,
+    const Leaderboard *leaderboard,
+    uint64_t first,
+    int n,
+    uint64_t current
+) {
+    ScoreItem items[NUMBER_HIGH_SCORES];
+    char line[64];
+
+    if (n > NUMBER_HIGH_SCORES) {
+        n = NUMBER_HIGH_SCORES;
+    }
+    if (fd >= 0) {
+        ScoreRequest request = {REQUEST_RANGE, n, first};
+        ScoreReply reply;
+        if (!scorenet_call(fd, &request, &reply) || reply.status != STATUS_OK) {
+            return;
+        }
+        n = reply.count;
+        memcpy(items, reply.items, n * sizeof(ScoreItem));
+    }
+    else {
+        uint64_t records[NUMBER_HIGH_SCORES];
+        n = leaderboard_range(leaderboard, first, n, records);
+        for (int i = 0; i < n; i++) {
+            items[i] = *scores_get(scores, records[i]);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        sprintf(
+            line,
+            "%4llu %s  %10.*s    %'9u\n",
+            (unsigned long long) first + i + 1,
+            first + i == current ? ">" : " ",
+            SCORES_NAME_LENGTH,
+            items[i].name,
+            items[i].score
+        );
+        strcat(text, line);
     }
-
-    free(string);
-    fclose(fp);
-    return;
-
-    error:
-        free(string);
-        fclose(fp);
 }
 
 
-void highscores_sort() {
-    Score key;
-    int j;
-    for (int i = 1; i < gNumberHighScores; i++) {
-        key = gHighScores[i];
-        for (j = i - 1; j >= 0 && gHighScores[j].score < key.score; j--) {
-            gHighScores[j + 1] = gHighScores[j];
+/* save the score of the game and list the best NUMBER_HIGH_SCORES ones in
+ * text, followed by the players around the current game if it is not
+ * among them; scores go through the score daemon when it runs so that
+ * several games can end at the same time */
+bool highscores_update(const char *name, int score, char *text) {
+    ScoreRequest request;
+    ScoreReply reply;
+    Scores *scores = NULL;
+    Leaderboard *leaderboard = NULL;
+    uint64_t rank = UINT64_MAX;  /* stays so if the daemon saved the score without ranking it */
+
+    memset(&request, 0, sizeof(ScoreRequest));
+    request.type = REQUEST_SUBMIT;
+    strncpy(request.item.name, name, SCORES_NAME_LENGTH);
+    request.item.score = score;
+    request.item.time = time(NULL);
+
+    int fd = scorenet_connect(HIGH_SCORES_SOCKET);
+    if (fd >= 0) {
+        check(scorenet_call(fd, &request, &reply), "Failed to reach the score daemon");
+        check(
+            reply.status == STATUS_OK || reply.status == STATUS_UNRANKED,
+            "The score daemon failed to save the score"
+        );
+        if (reply.status == STATUS_OK) {
+            rank = reply.rank;
         }
-        gHighScores[j + 1] = key;
     }
-}
-
+    else {
+        scores = scores_open(HIGH_SCORES_FILE);
+        check(scores != NULL, "Failed to open %s", HIGH_SCORES_FILE);
+        leaderboard = leaderboard_open(scores, HIGH_SCORES_INDEX);
+        check(leaderboard != NULL, "Failed to open %s", HIGH_SCORES_INDEX);
+        check(scores_append(scores, &request.item, 1), "Failed to save score");
+        check(leaderboard_update(leaderboard, scores), "Failed to rank score");
+        rank = leaderboard_position(leaderboard, scores->header.count - 1);
+    }
 
-void highscores_write() {
-    FILE *fp = fopen(HIGH_SCORES_FILE, "w");
-    check_mem(fp);
-    for (int i = 0; i < gNumberHighScores; i++) {
-        fprintf(fp, "%s;%d\n", gHighScores[i].name, gHighScores[i].score);
+    highscores_print(text, fd, scores, leaderboard, 0, NUMBER_HIGH_SCORES, rank);
+    if (rank >= NUMBER_HIGH_SCORES && rank != UINT64_MAX) {
+        uint64_t first = rank - HIGH_SCORES_AROUND;
+        if (first < NUMBER_HIGH_SCORES) {
+            first = NUMBER_HIGH_SCORES;
+        }
+        else {
+            strcat(text, "   ...\n");
+        }
+        highscores_print(text, fd, scores, leaderboard, first, rank + HIGH_SCORES_AROUND + 1 - first, rank);
     }
-    fclose(fp);
-    return;
+    if (fd >= 0) {
+        close(fd);
+    }
+    leaderboard_close(leaderboard);
+    scores_close(scores);
+    return true;
 
     error:
-        fclose(fp);
+        if (fd >= 0) {
+            close(fd);
+        }
+        leaderboard_close(leaderboard);
+        scores_close(scores);
+        return false;
 }
 
 
-bool initialize() {
+/* audio_samples is the size of the audio buffer in frames */
+bool initialize(int audio_samples) {
     check(
         SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) == 0,
         "Failed to initialize SDL: %s",
@@ -327,7 +427,7 @@ bool initialize() {
     gRenderer = SDL_CreateRenderer(
         gWindow,
         -1,
-        SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC
+        SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE
     );
     check_mem(gRenderer);
     SDL_SetRenderDrawColor(gRenderer, 0x41, 0x3D, 0x3D, 0xFF);
@@ -337,22 +437,13 @@ bool initialize() {
         "Failed to initialize SDL_image: %s",
         IMG_GetError()
     );
-    check(
-        Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) == 0,
-        "SDL_mixer could not initialize: %s",
-        Mix_GetError()
-    );
+    gAudio = audio_open(audio_samples);
+    check(gAudio != NULL, "Failed to open audio");
     check(
         TTF_Init() == 0,
         "SDL_ttf failed to initialize: %s",
         TTF_GetError()
     );
-
-    for (int i = 0; i < PLAYFIELD_CELL_HEIGHT; i++) {
-        for (int j = 0; j < PLAYFIELD_CELL_WIDTH; j++) {
-            gPlayfield[i][j] = 0;
-        }
-    }
     return true;
 
     error:
@@ -360,27 +451,41 @@ bool initialize() {
 }
 
 
-uint32_t level_timer_ticks(int level) {
-    uint32_t ticks = 1000 - (level - 1) * 100;
-    if (ticks < 0) {
-        return 50;
-    }
-    return ticks;
-}
-
-
+/* decode the assets in parallel, then make textures of them on this thread
+ * since the renderer is not thread-safe */
 bool load_media() {
-    check(
-        texture_from_file(&gCellTexture, CELL_TILES),
-        "Failed to load cells texture"
-    );
-    gPieceLanded = Mix_LoadWAV(PIECE_LANDED);
-    gClearRowOne = Mix_LoadWAV(CLEAR_ROW_ONE);
-    gClearRowTwo = Mix_LoadWAV(CLEAR_ROW_TWO);
-    gClearRowThree = Mix_LoadWAV(CLEAR_ROW_THREE);
-    gClearRowFour = Mix_LoadWAV(CLEAR_ROW_FOUR);
-    gFont = TTF_OpenFont("fonts/OpenSans-Regular.ttf", FONTSIZE);
-    check_mem(gFont);
+    SDL_Surface *cells = NULL;
+    MediaJob jobs[] = {
+        {CELL_TILES, MEDIA_IMAGE, (void **) &cells},
+        {FONT_FILE, MEDIA_FONT, (void **) &gFont},
+        {PIECE_LANDED, MEDIA_SOUND, (void **) &gPieceLanded},
+        {CLEAR_ROW_ONE, MEDIA_SOUND, (void **) &gClearRowOne},
+        {CLEAR_ROW_TWO, MEDIA_SOUND, (void **) &gClearRowTwo},
+        {CLEAR_ROW_THREE, MEDIA_SOUND, (void **) &gClearRowThree},
+        {CLEAR_ROW_FOUR, MEDIA_SOUND, (void **) &gClearRowFour}
+    };
+    int njobs = sizeof(jobs) / sizeof(jobs[0]);
+    Pool *pool = pool_new(0);
+
+    if (pool != NULL) {
+        pool_run(pool, njobs, media_decode, jobs);
+        pool_free(pool);
+    }
+    else {
+        for (int i = 0; i < njobs; i++) {
+            media_decode(jobs, i, 0);
+        }
+    }
+    for (int i = 0; i < njobs; i++) {
+        if (*jobs[i].result == NULL) {
+            log_warn("Failed to load %s: %s", jobs[i].path, jobs[i].error);
+        }
+    }
+    check(texture_from_surface(&gCellTexture, cells), "Failed to load cells texture");
+    check(gFont != NULL, "Failed to load %s", FONT_FILE);
+    SDL_Color text_color = {0xFF, 0xFF, 0xFF, 0xFF};
+    check(atlas_build(&gAtlas, gFont, text_color, gRenderer), "Failed to build glyph atlas");
+    check(playfield_texture_create(), "Failed to create playfield texture");
     return true;
 
     error:
@@ -388,272 +493,339 @@ bool load_media() {
 }
 
 
-bool piece_collided(Piece *p) {
-    for (int i = 0; i < PIECE_MATRIX_HEIGHT; i++) {
-        for (int j = 0; j < PIECE_MATRIX_WIDTH; j++) {
-            if (
-                p->matrix[i][j] == 1 &&
-                (
-                    j + p->posx < 0 ||
-                    j + p->posx >= PLAYFIELD_CELL_WIDTH ||
-                    i + p->posy >= PLAYFIELD_CELL_HEIGHT ||
-                    gPlayfield[i + p->posy][j + p->posx] != 0
-                )
-            ) {
-                return true;
-            }
-        }
+/* task: decode one asset, any thread can run it so the error goes with the
+ * job rather than staying with the thread */
+void media_decode(void *arg, int64_t index, int worker) {
+    MediaJob *job = &((MediaJob *) arg)[index];
+    SDL_RWops *rw = media_open(job->path);
+
+    if (rw == NULL) {
+        snprintf(job->error, sizeof(job->error), "%s", SDL_GetError());
+        return;
+    }
+    switch (job->kind) {
+        case MEDIA_IMAGE:
+            *job->result = IMG_Load_RW(rw, 1);
+            break;
+        case MEDIA_SOUND:
+            *job->result = audio_load(gAudio, rw);
+            break;
+        case MEDIA_FONT:
+            *job->result = TTF_OpenFontRW(rw, 1, FONTSIZE);
+            break;
+    }
+    if (*job->result == NULL) {
+        const char *error = job->kind == MEDIA_IMAGE ? IMG_GetError()
+            : job->kind == MEDIA_FONT ? TTF_GetError()
+            : SDL_GetError();
+        snprintf(job->error, sizeof(job->error), "%s", error);
     }
-    return false;
 }
 
 
-void piece_handle_event(Piece *p, SDL_Event e) {
-    bool collided = false;
-    /* if a key was pressed */
-    if (e.type == SDL_KEYDOWN && e.key.repeat == 0) {
-        /* adjust velocity */
-        switch (e.key.keysym.sym) {
-            case SDLK_DOWN:
-                p->vely += PIECE_VELOCITY;
-                break;
-            case SDLK_LEFT:
-                p->velx -= PIECE_VELOCITY;
-                break;
-            case SDLK_RIGHT:
-                p->velx += PIECE_VELOCITY;
-                break;
-            case SDLK_q:
-                if ((collided = piece_rotate_anticlock(p))) {
-                    piece_rotate_clock(p);
-                }
-                break;
-            case SDLK_w:
-                if ((collided = piece_rotate_clock(p))) {
-                    piece_rotate_anticlock(p);
-                }
-                break;
+/* the bytes of an asset, from the program itself if it was built with them
+ * or else from the working directory */
+SDL_RWops *media_open(const char *path) {
+#ifdef EMBED_ASSETS
+    for (int i = 0; i < NASSETS; i++) {
+        if (strcmp(ASSETS[i].path, path) == 0) {
+            return SDL_RWFromConstMem(ASSETS[i].data, ASSETS[i].size);
         }
     }
+#endif
+    return SDL_RWFromFile(path, "rb");
+}
 
-    /* if a key was released */
-    else if (e.type == SDL_KEYUP && e.key.repeat == 0) {
-        switch (e.key.keysym.sym) {
-            case SDLK_DOWN:
-                p->vely -= PIECE_VELOCITY;
-                /* make sure that piece will not go up */
-                if (p->vely < 0) {
-                    p->vely = 0;
-                }
-                break;
-            case SDLK_LEFT:
-                p->velx += PIECE_VELOCITY;
-                break;
-            case SDLK_RIGHT:
-                p->velx -= PIECE_VELOCITY;
-                break;
-        }
-    }
+
+double milliseconds(struct timespec *from, struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) * 1e3 + (to->tv_nsec - from->tv_nsec) / 1e6;
 }
 
 
-void piece_move(Piece *p) {
-    /* move the piece left or right */
-    p->posx += p->velx;
-    /* if the piece collided or went too far left or right, move back */
-    if (piece_collided(p)) {
-        p->posx -= p->velx;
+/* queue the game keys with the time they were pressed or released, the
+ * logic steps replay them */
+void input_handle_event(Ticker *t, SDL_Event e) {
+    int action;
+
+    if ((e.type != SDL_KEYDOWN && e.type != SDL_KEYUP) || e.key.repeat != 0) {
+        return;
     }
-    /* move the piece down */
-    p->posy += p->vely;
-    /* if the piece collided or went too far down, move back and record it as
-     * 'landed' (will be blocked and new piece will be spawned) */
-    if (piece_collided(p)) {
-        p->posy -= p->vely;
-        p->landed = true;
-        Mix_PlayChannel(-1, gPieceLanded, 0);
+    switch (e.key.keysym.sym) {
+        case SDLK_LEFT:
+            action = ACTION_LEFT;
+            break;
+        case SDLK_RIGHT:
+            action = ACTION_RIGHT;
+            break;
+        case SDLK_DOWN:
+            action = ACTION_DOWN;
+            break;
+        case SDLK_q:
+            action = ACTION_ROTATE_ANTICLOCK;
+            break;
+        case SDLK_w:
+            action = ACTION_ROTATE_CLOCK;
+            break;
+        default:
+            return;
+    }
+    if (!input_send(t, action, e.type == SDL_KEYDOWN, (uint64_t) e.key.timestamp * 1000)) {
+        log_warn("Input queue full, key event dropped");
     }
 }
 
 
-Piece *piece_spawn(Piece *pieces) {
-    int r = rand() % NPIECES;
-    Piece *p = &pieces[r];
-    p->posx = 6;
-    p->posy = 0;
-    p->velx = 0;
-    p->vely = 0;
-    p->landed = false;
-    return p;
+/* queue an input event for the logic steps and record it along with the
+ * step it was queued at */
+bool input_send(Ticker *t, int action, bool pressed, uint64_t time) {
+    if (!input_push(&gInput, action, pressed, time)) {
+        return false;
+    }
+    if (gRecorder != NULL) {
+        replay_event(gRecorder, &t->logic, action, pressed, time);
+    }
+    return true;
 }
 
 
-bool piece_rotate_anticlock(Piece *p) {
-    int new_matrix[PIECE_MATRIX_HEIGHT][PIECE_MATRIX_WIDTH];
-    for (int i = 0; i < PIECE_MATRIX_HEIGHT; i++) {
-        for (int j = 0; j < PIECE_MATRIX_WIDTH; j++) {
-            new_matrix[PIECE_MATRIX_WIDTH - 1 - j][i] = p->matrix[i][j];
-        }
+/* frame phase statistics drawn below the game information */
+void overlay_render() {
+    for (int i = 0; i < NPHASES + 3; i++) {
+        label_render(&gOverlayLabels[i], &gAtlas, gRenderer);
     }
-    for (int i = 0; i < PIECE_MATRIX_HEIGHT; i++) {
-        for (int j = 0; j < PIECE_MATRIX_WIDTH; j++) {
-            p->matrix[i][j] = new_matrix[i][j];
-        }
+}
+
+
+void overlay_update() {
+    PhaseStats stats;
+
+    label_printf(&gOverlayLabels[0], "phase  p50 / p99 / max (ms)");
+    for (int i = 0; i < NPHASES; i++) {
+        profiler_stats(&gProfiler, i, &stats);
+        label_printf(
+            &gOverlayLabels[i + 1],
+            "%s  %.2f / %.2f / %.2f",
+            PHASE_NAMES[i],
+            stats.p50 / 1000.0,
+            stats.p99 / 1000.0,
+            stats.max / 1000.0
+        );
     }
-    return piece_collided(p);
+    profiler_latency_stats(&gProfiler, &stats);
+    label_printf(
+        &gOverlayLabels[NPHASES + 1],
+        "input  %.2f / %.2f / %.2f",
+        stats.p50 / 1000.0,
+        stats.p99 / 1000.0,
+        stats.max / 1000.0
+    );
+    profiler_audio_stats(&gProfiler, &stats);
+    label_printf(
+        &gOverlayLabels[NPHASES + 2],
+        "audio  %.2f / %.2f / %.2f",
+        stats.p50 / 1000.0,
+        stats.p99 / 1000.0,
+        stats.max / 1000.0
+    );
 }
 
 
-bool piece_rotate_clock(Piece *p) {
-    int new_matrix[PIECE_MATRIX_HEIGHT][PIECE_MATRIX_WIDTH];
-    for (int i = 0; i < PIECE_MATRIX_WIDTH; i++) {
-        for (int j = 0; j < PIECE_MATRIX_HEIGHT; j++) {
-            new_matrix[j][PIECE_MATRIX_WIDTH - 1 - i] = p->matrix[i][j];
+bool parse_args(int argc, char *argv[], Options *opts) {
+    opts->seed = time(NULL);
+    opts->randomizer = RANDOMIZER_UNIFORM;
+    opts->profile_path = NULL;
+    opts->das = INPUT_DEFAULT_DAS;
+    opts->arr = INPUT_DEFAULT_ARR;
+    opts->bot = false;
+    opts->headless = false;
+    opts->bot_depth = BOT_DEFAULT_DEPTH;
+    opts->bot_width = BOT_DEFAULT_WIDTH;
+    opts->max_pieces = 0;
+    opts->record_path = NULL;
+    opts->audio_samples = AUDIO_DEFAULT_SAMPLES;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bag") == 0) {
+            opts->randomizer = RANDOMIZER_BAG;
         }
-    }
-    for (int i = 0; i < PIECE_MATRIX_HEIGHT; i++) {
-        for (int j = 0; j < PIECE_MATRIX_WIDTH; j++) {
-            p->matrix[i][j] = new_matrix[i][j];
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            opts->seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            opts->profile_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--das") == 0 && i + 1 < argc) {
+            opts->das = strtoul(argv[++i], NULL, 10) * 1000;
+        }
+        else if (strcmp(argv[i], "--arr") == 0 && i + 1 < argc) {
+            opts->arr = strtoul(argv[++i], NULL, 10) * 1000;
+        }
+        else if (strcmp(argv[i], "--bot") == 0) {
+            opts->bot = true;
+        }
+        else if (strcmp(argv[i], "--headless") == 0) {
+            opts->bot = true;
+            opts->headless = true;
+        }
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            opts->bot_depth = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--beam") == 0 && i + 1 < argc) {
+            opts->bot_width = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--pieces") == 0 && i + 1 < argc) {
+            opts->max_pieces = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            opts->record_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--audio-buffer") == 0 && i + 1 < argc) {
+            opts->audio_samples = atoi(argv[++i]);
+            check(opts->audio_samples > 0, "Audio buffer must hold at least one frame");
+        }
+        else {
+            sentinel("Unknown argument: %s", argv[i]);
         }
     }
-    return piece_collided(p);
+    return true;
+
+    error:
+        fprintf(
+            stderr,
+            "usage: %s [--seed N] [--bag] [--profile FILE.csv] [--record FILE] [--das MS] [--arr MS]\n"
+            "       [--audio-buffer FRAMES] [--bot [--headless [--pieces N]] [--depth N] [--beam N]]\n",
+            argv[0]
+        );
+        return false;
 }
 
 
-void playfield_add_piece(Piece *piece) {
-    /* iterate over playfied area */
-    for (int i = 0; i < PLAYFIELD_CELL_HEIGHT; i++) {
-        for (int j = 0; j < PLAYFIELD_CELL_WIDTH; j++) {
-            if (
-                j >= piece->posx &&
-                j < piece->posx + PIECE_MATRIX_WIDTH &&
-                i >= piece->posy &&
-                i < piece->posy + PIECE_MATRIX_HEIGHT &&
-                piece->matrix[i - piece->posy][j - piece->posx] == 1
-            ) {
-                gPlayfield[i][j] = piece->shape;
+/* draw the falling piece over the playfield as one batch of quads */
+void piece_render(Piece *p) {
+    SDL_Vertex vertices[4 * 4];
+    int indices[6 * 4];
+    const uint16_t *rows = piece_rotation(p)->rows;
+    float u0 = (float) p->shape * CELL_WIDTH / gCellTexture.width;
+    float u1 = (float) (p->shape + 1) * CELL_WIDTH / gCellTexture.width;
+    float v1 = (float) CELL_WIDTH / gCellTexture.height;
+    SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+    int n = 0;
+
+    for (int i = 0; i < PIECE_MATRIX_HEIGHT; i++) {
+        for (int j = 0; j < PIECE_MATRIX_WIDTH; j++) {
+            if (!(rows[i] & (1 << j))) {
+                continue;
             }
+            float x = (p->posx + j) * CELL_WIDTH + PLAYFIELD_POSITION_X;
+            float y = (p->posy + i) * CELL_WIDTH + PLAYFIELD_POSITION_Y;
+            SDL_Vertex *v = &vertices[4 * n];
+            v[0] = (SDL_Vertex) {{x, y}, white, {u0, 0}};
+            v[1] = (SDL_Vertex) {{x + CELL_WIDTH, y}, white, {u1, 0}};
+            v[2] = (SDL_Vertex) {{x + CELL_WIDTH, y + CELL_WIDTH}, white, {u1, v1}};
+            v[3] = (SDL_Vertex) {{x, y + CELL_WIDTH}, white, {u0, v1}};
+            int quad[6] = {4 * n, 4 * n + 1, 4 * n + 2, 4 * n, 4 * n + 2, 4 * n + 3};
+            memcpy(&indices[6 * n], quad, sizeof(quad));
+            n++;
         }
     }
+    SDL_RenderGeometry(gRenderer, gCellTexture.texture, vertices, 4 * n, indices, 6 * n);
 }
 
 
-int playfield_drop_full_rows() {
-    bool flag = false;  /* true if full rows detected */
-    int i, j, k;
-    int nrows = 0;  /* number of full rows, for score keeping */
-
-    /* full_rows: array to store index of full rows */
-    int full_rows[PLAYFIELD_CELL_HEIGHT], ptr;
-    for (ptr = 0; ptr < PLAYFIELD_CELL_HEIGHT; ptr++) {
-        full_rows[ptr] = -99; /* sentinel value */
+/* trigger the sounds matching what happened in the game since last call,
+ * the audio thread starts them with its next buffer */
+void play_sounds(Game *g) {
+    if (g->events & EVENT_PIECE_LANDED) {
+        audio_play(gAudio, gPieceLanded);
     }
-
-    /* get index of full rows */
-    ptr = 0;
-    for (i = PLAYFIELD_CELL_HEIGHT - 1; i >= 0; i--) {
-        for (j = 0; j < PLAYFIELD_CELL_WIDTH; j++) {
-            if (gPlayfield[i][j] == 0) {
-                break;
-            }
-        }
-        /* if we arrived at the end of the row without breaking then this is a
-         * full row */
-        if (j == PLAYFIELD_CELL_WIDTH) {
-            flag = true;
-            full_rows[ptr++] = i;
-        }
+    if (g->events & EVENT_CLEAR_ROW_ONE) {
+        audio_play(gAudio, gClearRowOne);
     }
-    nrows = ptr;
-
-    switch (nrows) {
-        case 1:
-            Mix_PlayChannel(-1, gClearRowOne, 0);
-            break;
-        case 2:
-            Mix_PlayChannel(-1, gClearRowTwo, 0);
-            break;
-        case 3:
-            Mix_PlayChannel(-1, gClearRowThree, 0);
-            break;
-        case 4:
-            Mix_PlayChannel(-1, gClearRowFour, 0);
-            break;
+    if (g->events & EVENT_CLEAR_ROW_TWO) {
+        audio_play(gAudio, gClearRowTwo);
     }
-
-    /* fill playfield and skip full rows if there are any */
-    if (flag == false) {
-        return nrows;
+    if (g->events & EVENT_CLEAR_ROW_THREE) {
+        audio_play(gAudio, gClearRowThree);
     }
-    ptr = 0;
-    k = PLAYFIELD_CELL_HEIGHT - 1;
-    for (i = PLAYFIELD_CELL_HEIGHT - 1; i >= 0; i--, k--) {
-        /* skip full rows */
-        while (ptr < PLAYFIELD_CELL_HEIGHT && k == full_rows[ptr]) {
-            k--;
-            ptr++;
-        }
-        for (j = 0; j < PLAYFIELD_CELL_WIDTH; j++) {
-            if (k < 0) {
-                gPlayfield[i][j] = 0;
-            }
-            else {
-                gPlayfield[i][j] = gPlayfield[k][j];
-            }
-        }
+    if (g->events & EVENT_CLEAR_ROW_FOUR) {
+        audio_play(gAudio, gClearRowFour);
     }
+    g->events = 0;
+}
+
 
-    return nrows;
+/* forget what the playfield texture shows so that every cell is redrawn */
+void playfield_invalidate() {
+    memset(gPlayfieldDrawn, 0xFF, sizeof(gPlayfieldDrawn));
+    gPlayfieldGeneration = gGame.board.generation - 1;
 }
 
 
-void playfield_print() {
-    printf("\n");
-    for (int i = 0; i < PLAYFIELD_CELL_HEIGHT; i++) {
-        for (int j = 0; j < PLAYFIELD_CELL_WIDTH; j++) {
-            printf("%d", gPlayfield[i][j]);
-        }
-        printf("\n");
+/* copy the playfield texture to the screen, the board only changes when a
+ * piece locks so most frames this is all there is to do */
+void playfield_render() {
+    if (gPlayfieldGeneration != gGame.board.generation) {
+        playfield_update();
     }
+
+    SDL_Rect quad = {
+        PLAYFIELD_POSITION_X,
+        PLAYFIELD_POSITION_Y,
+        PLAYFIELD_WIDTH,
+        PLAYFIELD_HEIGHT
+    };
+    SDL_RenderCopy(gRenderer, gPlayfieldTexture, NULL, &quad);
 }
 
 
-void playfield_remove_piece(Piece *piece) {
-    /* iterate over playfied area */
-    for (int i = 0; i < PLAYFIELD_CELL_HEIGHT; i++) {
-        for (int j = 0; j < PLAYFIELD_CELL_WIDTH; j++) {
-            if (
-                j >= piece->posx &&
-                j < piece->posx + PIECE_MATRIX_WIDTH &&
-                i >= piece->posy &&
-                i < piece->posy + PIECE_MATRIX_HEIGHT &&
-                piece->matrix[i - piece->posy][j - piece->posx] == 1
-            ) {
-                gPlayfield[i][j] = 0;
-            }
-        }
-    }
+bool playfield_texture_create() {
+    gPlayfieldTexture = SDL_CreateTexture(
+        gRenderer,
+        SDL_PIXELFORMAT_RGBA8888,
+        SDL_TEXTUREACCESS_TARGET,
+        PLAYFIELD_WIDTH,
+        PLAYFIELD_HEIGHT
+    );
+    check(gPlayfieldTexture != NULL, "Failed to create texture: %s", SDL_GetError());
+    playfield_invalidate();
+    return true;
+
+    error:
+        return false;
 }
 
 
-void playfield_render() {
-    int x, y;  /* pixel position on the screen */
+/* bring the playfield texture up to date with the locked cells, redrawing
+ * only the cells that changed since it was last updated */
+void playfield_update() {
+    bool target_set = false;
 
-    /* iterate over playfied area */
     for (int i = 0; i < PLAYFIELD_CELL_HEIGHT; i++) {
+        if (memcmp(gPlayfieldDrawn[i], gGame.board.cells[i], PLAYFIELD_CELL_WIDTH) == 0) {
+            continue;
+        }
+        if (!target_set) {
+            SDL_SetRenderTarget(gRenderer, gPlayfieldTexture);
+            target_set = true;
+        }
         for (int j = 0; j < PLAYFIELD_CELL_WIDTH; j++) {
-            x = j * CELL_WIDTH + PLAYFIELD_POSITION_X;
-            y = i * CELL_WIDTH + PLAYFIELD_POSITION_Y;
+            if (gPlayfieldDrawn[i][j] == gGame.board.cells[i][j]) {
+                continue;
+            }
             /* draw cells with appropriate color */
             SDL_Rect clip = {
-                gPlayfield[i][j] * CELL_WIDTH,
+                gGame.board.cells[i][j] * CELL_WIDTH,
                 0,
                 CELL_WIDTH,
                 CELL_WIDTH
             };
-            texture_render(&gCellTexture, x, y, &clip, gRenderer);
+            texture_render(&gCellTexture, j * CELL_WIDTH, i * CELL_WIDTH, &clip, gRenderer);
+            gPlayfieldDrawn[i][j] = gGame.board.cells[i][j];
         }
     }
+    if (target_set) {
+        SDL_SetRenderTarget(gRenderer, NULL);
+    }
+    gPlayfieldGeneration = gGame.board.generation;
 }
 
 
@@ -691,24 +863,24 @@ void texture_destroy(Texture *t) {
 }
 
 
-bool texture_from_file(Texture *t, char *path) {
+/* the surface is freed, whether it could be made a texture or not */
+bool texture_from_surface(Texture *t, SDL_Surface *surface) {
     texture_destroy(t);
-    SDL_Surface *loaded_surface = IMG_Load(path);
-    check_mem(loaded_surface);
+    check_mem(surface);
     SDL_SetColorKey(
-        loaded_surface,
+        surface,
         SDL_TRUE,
-        SDL_MapRGB(loaded_surface->format, 0, 0xFF, 0xFF)
+        SDL_MapRGB(surface->format, 0, 0xFF, 0xFF)
     );
-    t->texture = SDL_CreateTextureFromSurface(gRenderer, loaded_surface);
+    t->texture = SDL_CreateTextureFromSurface(gRenderer, surface);
     check_mem(t->texture);
-    t->width = loaded_surface->w;
-    t->height = loaded_surface->h;
-    SDL_FreeSurface(loaded_surface);
+    t->width = surface->w;
+    t->height = surface->h;
+    SDL_FreeSurface(surface);
     return true;
 
     error:
-        SDL_FreeSurface(loaded_surface);
+        SDL_FreeSurface(surface);
         return false;
 }
 
@@ -739,6 +911,39 @@ void texture_render(Texture *t, int x, int y, SDL_Rect *clip, SDL_Renderer *rend
 }
 
 
+/* number of logic steps due since the last call, if the game fell too far
+ * behind the time it cannot catch up is dropped */
+int ticker_advance(Ticker *t) {
+    uint64_t now = SDL_GetPerformanceCounter();
+    int steps = 0;
+
+    t->lag += now - t->last;
+    t->last = now;
+    while (t->lag >= t->period && steps < LOGIC_MAX_STEPS) {
+        t->lag -= t->period;
+        steps++;
+    }
+    if (steps == LOGIC_MAX_STEPS) {
+        /* skip the time that is dropped */
+        uint64_t dropped = t->lag * 1000000 / SDL_GetPerformanceFrequency();
+        logic_skip(&t->logic, dropped);
+        if (gRecorder != NULL) {
+            replay_skip(gRecorder, &t->logic, dropped);
+        }
+        t->lag = 0;
+    }
+    return steps;
+}
+
+
+void ticker_start(Ticker *t) {
+    memset(t, 0, sizeof(Ticker));
+    t->period = SDL_GetPerformanceFrequency() / LOGIC_HZ;
+    t->last = SDL_GetPerformanceCounter();
+    logic_init(&t->logic, (uint64_t) SDL_GetTicks() * 1000);
+}
+
+
 uint32_t timer_get_ticks(Timer *t) {
     uint32_t time = 0;
     if (t->started) {
@@ -760,140 +965,178 @@ void timer_stop(Timer *t) {
 }
 
 
-bool update_level(int current_level, int total_rows) {
-    return total_rows >= current_level * FULL_ROWS_PER_LEVEL;
-}
-
-
-int update_score(int level, int nrows) {
-    return level * POINTS[nrows];
-}
-
-
 int main(int argc, char *argv[]) {
-    srand(time(NULL));
-    check(initialize(), "Failed to initialize");
+    struct timespec launched, initialized, loaded, presented;
+    clock_gettime(CLOCK_MONOTONIC, &launched);
+    Options opts;
+    if (!parse_args(argc, argv, &opts)) {
+        return -1;
+    }
+    game_init(&gGame, opts.seed, opts.randomizer);
+    if (opts.headless) {
+        return bot_headless(&opts) ? 0 : 1;
+    }
+    check(initialize(opts.audio_samples), "Failed to initialize");
+    clock_gettime(CLOCK_MONOTONIC, &initialized);
     check(load_media(), "Failed to load media");
+    clock_gettime(CLOCK_MONOTONIC, &loaded);
+    bool first_frame = true;
     bool quit = false;
     SDL_Event e;
     Timer frame_timer;
-    Timer game_timer;
-    int score = 0;
-    int level = 1;
-    int nrows = 0;  /* number of full rows achieved when a piece lands */
-    int total_rows = 0;  /* total number of full rows made in the game */
-    char score_text[40];
+    Ticker ticker;
+    SDL_RendererInfo renderer_info;
     char player_name[PLAYER_NAME_LENGTH] = "";  /* stored in the high scores list */
     char high_scores_text[1000] = "Rank          Name        Score\n\n";
-    char high_score_line[33];
-    gNumberHighScores = 1;  /* we have at least the current game's score */
-    char level_text[40];
-    char total_rows_text[40];
     SDL_Color text_color = {0xFF, 0xFF, 0xFF, 0xFF};
-    Piece pieces[NPIECES] = {
-        piece_I, piece_J, piece_L, piece_O, piece_S, piece_T, piece_Z
-    };
-    Piece *current_piece = piece_spawn(pieces);
-
-    timer_start(&game_timer);
+    Piece *current_piece = &gGame.current_piece;
+    uint32_t overlay_updated = 0;
+
+    label_init(&gScoreLabel, INFOFIELD_POSITION_X, INFOFIELD_POSITION_Y);
+    label_init(&gLevelLabel, INFOFIELD_POSITION_X, INFOFIELD_POSITION_Y + FONTSIZE * 1.25);
+    label_init(&gTotalRowsLabel, INFOFIELD_POSITION_X, INFOFIELD_POSITION_Y + 2 * FONTSIZE * 1.25);
+    for (int i = 0; i < NPHASES + 3; i++) {
+        label_init(
+            &gOverlayLabels[i],
+            INFOFIELD_POSITION_X,
+            INFOFIELD_POSITION_Y + (5 + i) * FONTSIZE * 1.25
+        );
+    }
+    profiler_init(&gProfiler);
+    gShowOverlay = opts.profile_path != NULL;
+    if (SDL_GetRendererInfo(gRenderer, &renderer_info) == 0) {
+        gVsync = renderer_info.flags & SDL_RENDERER_PRESENTVSYNC;
+    }
+    input_init(&gInput, opts.das, opts.arr);
+    ticker_start(&ticker);
+    if (opts.record_path != NULL) {
+        gRecorder = replay_new(opts.record_path, &gGame, &gInput, &ticker.logic);
+        check(gRecorder != NULL, "Failed to start recording");
+    }
+    if (opts.bot) {
+        gPool = pool_new(0);
+        check(gPool != NULL, "Failed to start thread pool");
+        gBot = bot_new(gPool, opts.bot_depth, opts.bot_width);
+        check(gBot != NULL, "Failed to create bot");
+    }
+    uint64_t bot_start = SDL_GetPerformanceCounter();
 
     while (!quit) {
         timer_start(&frame_timer);
+        profiler_begin_frame(&gProfiler);
 
         /* handle events and movements */
         while (SDL_PollEvent(&e) != 0) {
             if (e.type == SDL_QUIT) {
                 quit = true;
             }
-            piece_handle_event(current_piece, e);
-        }
-
-        /* descend piece on playfield */
-        if (timer_get_ticks(&game_timer) > level_timer_ticks(level)) {
-            timer_start(&game_timer);
-            /* descend only if piece is not already moving down */
-            if (current_piece->vely == 0) {
-                current_piece->vely += PIECE_VELOCITY;
-                piece_move(current_piece);
-                current_piece->vely -= PIECE_VELOCITY;
+            /* the renderer may drop the content of target textures */
+            if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET) {
+                playfield_invalidate();
             }
+            /* F3 shows or hides frame timings */
+            if (e.type == SDL_KEYDOWN && e.key.repeat == 0 && e.key.keysym.sym == SDLK_F3) {
+                gShowOverlay = !gShowOverlay;
+            }
+            /* time key presses until they show up on screen */
+            else if (e.type == SDL_KEYDOWN && e.key.repeat == 0) {
+                profiler_input(&gProfiler, (SDL_GetTicks() - e.key.timestamp) * 1000);
+            }
+            if (gBot == NULL) {
+                input_handle_event(&ticker, e);
+            }
+        }
+        if (gBot != NULL) {
+            bot_drive(&ticker);
         }
+        profiler_mark(&gProfiler, PHASE_EVENTS);
 
-        piece_move(current_piece);
+        /* run as many logic steps as the time since last frame holds */
+        for (int steps = ticker_advance(&ticker); steps > 0 && !gGame.over; steps--) {
+            logic_step(&ticker.logic, &gGame, &gInput);
+        }
+        if (gGame.over) {
+            quit = true;
+        }
+        play_sounds(&gGame);
+        uint32_t latency;
+        while (audio_latency(gAudio, &latency)) {
+            profiler_audio(&gProfiler, latency);
+        }
+        profiler_mark(&gProfiler, PHASE_LOGIC);
 
         SDL_SetRenderDrawColor(gRenderer, 0x41, 0x3D, 0x3D, 0xFF);
         SDL_RenderClear(gRenderer);
 
-        /* update the playfield and draw it */
-        playfield_add_piece(current_piece);
+        /* draw the locked cells then the falling piece on top */
         playfield_render();
-        if (current_piece->landed) {
-            nrows = playfield_drop_full_rows();
-            total_rows += nrows;
-            score += update_score(level, nrows);
-            if (nrows != 0 && update_level(level, total_rows)) {
-                level++;
-            }
-            current_piece = piece_spawn(pieces);
-            /* if piece is spawned over anoter piece the game is over */
-            if (piece_collided(current_piece)) {
-                quit = true;
+        piece_render(current_piece);
+        profiler_mark(&gProfiler, PHASE_RENDER);
+
+        /* print information (score, ...), labels only rebuild their quads
+         * when the text changes */
+        label_printf(&gScoreLabel, "Score: %d", gGame.score);
+        label_printf(&gLevelLabel, "Level: %d", gGame.level);
+        label_printf(&gTotalRowsLabel, "Total rows: %d", gGame.total_rows);
+        label_render(&gScoreLabel, &gAtlas, gRenderer);
+        label_render(&gLevelLabel, &gAtlas, gRenderer);
+        label_render(&gTotalRowsLabel, &gAtlas, gRenderer);
+        if (gShowOverlay) {
+            if (SDL_GetTicks() - overlay_updated >= OVERLAY_REFRESH_TICKS) {
+                overlay_update();
+                overlay_updated = SDL_GetTicks();
             }
+            overlay_render();
         }
-        else {
-            playfield_remove_piece(current_piece);
-        }
-
-        /* print information (score, ...) */
-        sprintf(score_text, "Score: %d", score);
-        sprintf(level_text, "Level: %d", level);
-        sprintf(total_rows_text, "Total rows: %d", total_rows);
-        check(
-            texture_from_text(&gScoreInfoTexture, score_text, text_color, gRenderer),
-            "Failed to render score info texture"
-        );
-        check(
-            texture_from_text(&gLevelInfoTexture, level_text, text_color, gRenderer),
-            "Failed to render level info texture"
-        );
-        check(
-            texture_from_text(
-                &gTotalRowsInfoTexture,
-                total_rows_text,
-                text_color,
-                gRenderer
-            ),
-            "Failed to render total rows info texture"
-        );
-        texture_render(
-            &gScoreInfoTexture,
-            INFOFIELD_POSITION_X,
-            INFOFIELD_POSITION_Y,
-            NULL,
-            gRenderer
-        );
-        texture_render(
-            &gLevelInfoTexture,
-            INFOFIELD_POSITION_X,
-            INFOFIELD_POSITION_Y + FONTSIZE * 1.25,
-            NULL,
-            gRenderer
-        );
-        texture_render(
-            &gTotalRowsInfoTexture,
-            INFOFIELD_POSITION_X,
-            INFOFIELD_POSITION_Y + 2 * FONTSIZE * 1.25,
-            NULL,
-            gRenderer
-        );
+        profiler_mark(&gProfiler, PHASE_TEXT);
 
         SDL_RenderPresent(gRenderer);
+        profiler_presented(&gProfiler);
+        if (first_frame) {
+            clock_gettime(CLOCK_MONOTONIC, &presented);
+            fprintf(
+                stderr,
+                "First frame after %.1f ms: %.1f ms to initialize, %.1f ms to load media\n",
+                milliseconds(&launched, &presented),
+                milliseconds(&launched, &initialized),
+                milliseconds(&initialized, &loaded)
+            );
+        }
+        first_frame = false;
+        profiler_mark(&gProfiler, PHASE_PRESENT);
 
-        /* cap frame rate */
+        /* frames go at the display refresh rate, only cap them when
+         * presenting does not wait for it */
         int frame_ticks = timer_get_ticks(&frame_timer);
-        if (frame_ticks < SCREEN_TICKS_PER_FRAME) {
-            SDL_Delay(SCREEN_TICKS_PER_FRAME - frame_ticks);
+        if (!gVsync && frame_ticks < 1000 / FALLBACK_FPS) {
+            SDL_Delay(1000 / FALLBACK_FPS - frame_ticks);
         }
+        profiler_mark(&gProfiler, PHASE_DELAY);
+        profiler_end_frame(&gProfiler);
+    }
+
+    if (opts.profile_path != NULL) {
+        profiler_write_csv(&gProfiler, opts.profile_path);
+    }
+    if (gRecorder != NULL && !replay_end(gRecorder, &ticker.logic, &gGame)) {
+        log_warn("Failed to record the game to %s", opts.record_path);
+    }
+
+    /* an unattended run has nobody to type a name */
+    if (gBot != NULL) {
+        double seconds = (double) (SDL_GetPerformanceCounter() - bot_start) / SDL_GetPerformanceFrequency();
+        printf(
+            "%d pieces, %d rows, level %d, score %d in %.3f s: %.1f pieces/s\n",
+            gGame.pieces_spawned,
+            gGame.total_rows,
+            gGame.level,
+            gGame.score,
+            seconds,
+            gGame.pieces_spawned / seconds
+        );
+        bot_print_stats();
+        close_all();
+        return 0;
     }
 
 
@@ -997,19 +1240,8 @@ int main(int argc, char *argv[]) {
     SDL_DestroyWindow(gInputWindow);
     gInputWindow = NULL;
 
-    highscores_read();
-    strcpy(gHighScores[0].name, player_name);
-    gHighScores[0].score = score;
-    highscores_sort();
-    highscores_write();
-
-    for (int i = 0; i < gNumberHighScores; i++) {
-        sprintf(
-            high_score_line,
-            "%4d    %10s    %'9d\n",
-            i + 1, gHighScores[i].name, gHighScores[i].score
-        );
-        strcat(high_scores_text, high_score_line);
+    if (!highscores_update(player_name, gGame.score, high_scores_text)) {
+        strcat(high_scores_text, "High scores are not available");
     }
 
     SDL_ShowSimpleMessageBox(
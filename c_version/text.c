@@ -0,0 +1,148 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "text.h"
+
+
+static void label_build(Label *, Atlas *);
+
+
+/* render each glyph once and pack them in rows of at most ATLAS_WIDTH pixels
+ * into a single texture */
+bool atlas_build(Atlas *a, TTF_Font *font, SDL_Color color, SDL_Renderer *renderer) {
+    SDL_Surface *glyphs[ATLAS_NGLYPHS] = {NULL};
+    SDL_Surface *atlas_surface = NULL;
+    int x = 0, y = 0;
+
+    atlas_destroy(a);
+    a->line_height = TTF_FontHeight(font);
+    for (int i = 0; i < ATLAS_NGLYPHS; i++) {
+        Glyph *g = &a->glyphs[i];
+        int minx, maxx, miny, maxy;
+        check(
+            TTF_GlyphMetrics(font, ATLAS_FIRST_GLYPH + i, &minx, &maxx, &miny, &maxy, &g->advance) == 0,
+            "Failed to get metrics of glyph %d: %s",
+            ATLAS_FIRST_GLYPH + i,
+            TTF_GetError()
+        );
+        glyphs[i] = TTF_RenderGlyph_Solid(font, ATLAS_FIRST_GLYPH + i, color);
+        check(glyphs[i] != NULL, "Failed to render glyph: %s", TTF_GetError());
+        if (x + glyphs[i]->w > ATLAS_WIDTH) {
+            x = 0;
+            y += a->line_height;
+        }
+        g->clip.x = x;
+        g->clip.y = y;
+        g->clip.w = glyphs[i]->w;
+        g->clip.h = glyphs[i]->h;
+        x += glyphs[i]->w;
+    }
+    a->width = ATLAS_WIDTH;
+    a->height = y + a->line_height;
+
+    atlas_surface = SDL_CreateRGBSurfaceWithFormat(0, a->width, a->height, 32, SDL_PIXELFORMAT_RGBA32);
+    check(atlas_surface != NULL, "Failed to create atlas surface: %s", SDL_GetError());
+    for (int i = 0; i < ATLAS_NGLYPHS; i++) {
+        SDL_BlitSurface(glyphs[i], NULL, atlas_surface, &a->glyphs[i].clip);
+        SDL_FreeSurface(glyphs[i]);
+        glyphs[i] = NULL;
+    }
+    a->texture = SDL_CreateTextureFromSurface(renderer, atlas_surface);
+    check(a->texture != NULL, "Failed to create atlas texture: %s", SDL_GetError());
+    SDL_SetTextureBlendMode(a->texture, SDL_BLENDMODE_BLEND);
+    SDL_FreeSurface(atlas_surface);
+    return true;
+
+    error:
+        for (int i = 0; i < ATLAS_NGLYPHS; i++) {
+            SDL_FreeSurface(glyphs[i]);
+        }
+        SDL_FreeSurface(atlas_surface);
+        return false;
+}
+
+
+void atlas_destroy(Atlas *a) {
+    if (a->texture != NULL) {
+        SDL_DestroyTexture(a->texture);
+        a->texture = NULL;
+    }
+}
+
+
+/* two triangles per glyph, characters missing from the atlas are skipped */
+static void label_build(Label *l, Atlas *a) {
+    SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+    int x = l->x;
+    int n = 0;
+
+    for (const char *c = l->text; *c != '\0'; c++) {
+        if (*c < ATLAS_FIRST_GLYPH || *c > ATLAS_LAST_GLYPH) {
+            continue;
+        }
+        Glyph *g = &a->glyphs[*c - ATLAS_FIRST_GLYPH];
+        SDL_Vertex *v = &l->vertices[4 * n];
+        int *index = &l->indices[6 * n];
+        float u0 = (float) g->clip.x / a->width;
+        float v0 = (float) g->clip.y / a->height;
+        float u1 = (float) (g->clip.x + g->clip.w) / a->width;
+        float v1 = (float) (g->clip.y + g->clip.h) / a->height;
+
+        v[0] = (SDL_Vertex) {{x, l->y}, white, {u0, v0}};
+        v[1] = (SDL_Vertex) {{x + g->clip.w, l->y}, white, {u1, v0}};
+        v[2] = (SDL_Vertex) {{x + g->clip.w, l->y + g->clip.h}, white, {u1, v1}};
+        v[3] = (SDL_Vertex) {{x, l->y + g->clip.h}, white, {u0, v1}};
+        index[0] = 4 * n;
+        index[1] = 4 * n + 1;
+        index[2] = 4 * n + 2;
+        index[3] = 4 * n;
+        index[4] = 4 * n + 2;
+        index[5] = 4 * n + 3;
+        x += g->advance;
+        n++;
+    }
+    l->nglyphs = n;
+    l->width = x - l->x;
+    l->dirty = false;
+}
+
+
+void label_init(Label *l, int x, int y) {
+    l->text[0] = '\0';
+    l->x = x;
+    l->y = y;
+    l->width = 0;
+    l->nglyphs = 0;
+    l->dirty = true;
+}
+
+
+/* set the text of a label, it is only marked for rebuilding if the text
+ * actually changed */
+void label_printf(Label *l, const char *format, ...) {
+    char text[LABEL_LENGTH];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(text, LABEL_LENGTH, format, args);
+    va_end(args);
+    if (strcmp(text, l->text) != 0) {
+        strcpy(l->text, text);
+        l->dirty = true;
+    }
+}
+
+
+void label_render(Label *l, Atlas *a, SDL_Renderer *renderer) {
+    if (l->dirty) {
+        label_build(l, a);
+    }
+    if (l->nglyphs > 0) {
+        SDL_RenderGeometry(renderer, a->texture, l->vertices, 4 * l->nglyphs, l->indices, 6 * l->nglyphs);
+    }
+}
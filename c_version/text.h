@@ -0,0 +1,50 @@
+#ifndef __text_h__
+#define __text_h__
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdbool.h>
+
+
+#define ATLAS_FIRST_GLYPH 32  /* space */
+#define ATLAS_LAST_GLYPH 126  /* tilde */
+#define ATLAS_NGLYPHS (ATLAS_LAST_GLYPH - ATLAS_FIRST_GLYPH + 1)
+#define ATLAS_WIDTH 512  /* glyphs wrap to a new line of the atlas past this */
+#define LABEL_LENGTH 64
+
+
+typedef struct glyph {
+    SDL_Rect clip;  /* where the glyph is in the atlas */
+    int advance;  /* horizontal distance to the next glyph */
+} Glyph;
+
+/* every printable ASCII glyph of a font rendered once into a texture */
+typedef struct atlas {
+    SDL_Texture *texture;
+    int width;
+    int height;
+    int line_height;
+    Glyph glyphs[ATLAS_NGLYPHS];
+} Atlas;
+
+/* a line of text drawn from an atlas, its quads are only rebuilt when the
+ * text changes */
+typedef struct label {
+    char text[LABEL_LENGTH];
+    int x;
+    int y;
+    int width;
+    int nglyphs;
+    bool dirty;
+    SDL_Vertex vertices[4 * LABEL_LENGTH];
+    int indices[6 * LABEL_LENGTH];
+} Label;
+
+
+bool atlas_build(Atlas *, TTF_Font *, SDL_Color, SDL_Renderer *);
+void atlas_destroy(Atlas *);
+void label_init(Label *, int, int);
+void label_printf(Label *, const char *, ...);
+void label_render(Label *, Atlas *, SDL_Renderer *);
+
+#endif
@@ -0,0 +1,236 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "threadpool.h"
+
+
+#define CACHE_LINE 64
+
+
+/* tasks [next, end) not started yet, the owner takes them from the front and
+ * thieves take the back half */
+typedef struct range {
+    pthread_mutex_t lock;
+    int64_t next;
+    int64_t end;
+} __attribute__((aligned(CACHE_LINE))) Range;
+
+struct pool {
+    int nthreads;
+    pthread_t *threads;
+    Range *ranges;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t finished;
+    uint64_t generation;  /* incremented for each batch */
+    int busy;  /* worker threads still running the current batch */
+    bool quit;
+    TaskFunction function;
+    void *arg;
+};
+
+typedef struct worker {
+    Pool *pool;
+    int id;
+} Worker;
+
+
+static bool range_pop(Range *, int64_t *);
+static bool range_steal(Pool *, int);
+static void work(Pool *, int);
+static void *worker_loop(void *);
+
+
+void pool_free(Pool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; pool->threads != NULL && i < pool->nthreads && pool->threads[i] != 0; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i < pool->nthreads && pool->ranges != NULL; i++) {
+        pthread_mutex_destroy(&pool->ranges[i].lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->finished);
+    free(pool->threads);
+    free(pool->ranges);
+    free(pool);
+}
+
+
+/* start a pool of nthreads workers, the calling thread counts as one of them,
+ * nthreads <= 0 means one per online CPU */
+Pool *pool_new(int nthreads) {
+    Pool *pool = NULL;
+    if (nthreads <= 0) {
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (nthreads <= 0) {
+        nthreads = 1;
+    }
+
+    pool = calloc(1, sizeof(Pool));
+    check_mem(pool);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    pool->nthreads = nthreads;
+    pool->threads = calloc(nthreads, sizeof(pthread_t));
+    check_mem(pool->threads);
+    check(
+        posix_memalign((void **) &pool->ranges, CACHE_LINE, nthreads * sizeof(Range)) == 0,
+        "Failed to allocate work ranges"
+    );
+    for (int i = 0; i < nthreads; i++) {
+        pthread_mutex_init(&pool->ranges[i].lock, NULL);
+        pool->ranges[i].next = 0;
+        pool->ranges[i].end = 0;
+    }
+
+    for (int i = 1; i < nthreads; i++) {
+        Worker *w = malloc(sizeof(Worker));
+        check_mem(w);
+        w->pool = pool;
+        w->id = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_loop, w) != 0) {
+            free(w);
+            pool->nthreads = i;  /* only join the threads that exist */
+            sentinel("Failed to start worker thread %d", i);
+        }
+    }
+    return pool;
+
+    error:
+        pool_free(pool);
+        return NULL;
+}
+
+
+/* run function(arg, i, worker) for i in [0, ntasks) on all workers and
+ * return once every task is done */
+void pool_run(Pool *pool, int64_t ntasks, TaskFunction function, void *arg) {
+    int64_t chunk = ntasks / pool->nthreads;
+    int64_t extra = ntasks % pool->nthreads;
+    int64_t next = 0;
+
+    /* even split to begin with, stealing takes care of the imbalance */
+    for (int i = 0; i < pool->nthreads; i++) {
+        pool->ranges[i].next = next;
+        next += chunk + (i < extra ? 1 : 0);
+        pool->ranges[i].end = next;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->function = function;
+    pool->arg = arg;
+    pool->busy = pool->nthreads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    work(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+int pool_size(Pool *pool) {
+    return pool->nthreads;
+}
+
+
+static bool range_pop(Range *r, int64_t *task) {
+    bool found = false;
+    pthread_mutex_lock(&r->lock);
+    if (r->next < r->end) {
+        *task = r->next++;
+        found = true;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return found;
+}
+
+
+/* move the back half of another worker's range into our own, return false if
+ * every other range is empty */
+static bool range_steal(Pool *pool, int id) {
+    for (int k = 1; k < pool->nthreads; k++) {
+        Range *victim = &pool->ranges[(id + k) % pool->nthreads];
+        int64_t start, end;
+
+        pthread_mutex_lock(&victim->lock);
+        end = victim->end;
+        start = end - (end - victim->next) / 2;
+        if (start == end && victim->next < end) {
+            start = end - 1;  /* a single task left, take it */
+        }
+        victim->end = start;
+        pthread_mutex_unlock(&victim->lock);
+
+        if (start < end) {
+            Range *own = &pool->ranges[id];
+            pthread_mutex_lock(&own->lock);
+            own->next = start;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/* tasks are never added during a batch, so once no range has anything left
+ * to steal the worker is done */
+static void work(Pool *pool, int id) {
+    int64_t task;
+    do {
+        while (range_pop(&pool->ranges[id], &task)) {
+            pool->function(pool->arg, task, id);
+        }
+    } while (range_steal(pool, id));
+}
+
+
+static void *worker_loop(void *arg) {
+    Worker *w = arg;
+    Pool *pool = w->pool;
+    int id = w->id;
+    uint64_t seen = 0;
+    free(w);
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->quit && pool->generation == seen) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->quit) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        work(pool, id);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->finished);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef __threadpool_h__
+#define __threadpool_h__
+
+#include <stdint.h>
+
+
+/* task i of a batch, worker is the id of the thread running it (0 is the
+ * thread that called pool_run) so callers can keep per-thread scratch data */
+typedef void (*TaskFunction)(void *, int64_t, int);
+
+typedef struct pool Pool;
+
+
+void pool_free(Pool *);
+Pool *pool_new(int);
+void pool_run(Pool *, int64_t, TaskFunction, void *);
+int pool_size(Pool *);
+
+#endif
@@ -0,0 +1,87 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "tt.h"
+
+
+void tt_free(TT *tt) {
+    if (tt == NULL) {
+        return;
+    }
+    free(tt->entries);
+    free(tt->counters);
+    free(tt);
+}
+
+
+/* a table of 2^bits entries of 16 bytes, used by worker ids from 0 to
+ * nworkers - 1 */
+TT *tt_new(int bits, int nworkers) {
+    TT *tt = calloc(1, sizeof(TT));
+    check_mem(tt);
+    check(bits > 0 && bits < 40, "Table size must be from 2^1 to 2^39 entries");
+    check(nworkers >= 1, "Table needs at least one worker");
+    tt->mask = ((uint64_t) 1 << bits) - 1;
+    tt->entries = calloc(tt->mask + 1, sizeof(TTEntry));
+    check_mem(tt->entries);
+    check(
+        posix_memalign((void **) &tt->counters, TT_CACHE_LINE, nworkers * sizeof(TTCounters)) == 0,
+        "Failed to allocate table counters"
+    );
+    memset(tt->counters, 0, nworkers * sizeof(TTCounters));
+    tt->nworkers = nworkers;
+    return tt;
+
+    error:
+        tt_free(tt);
+        return NULL;
+}
+
+
+/* look a key up, the data stored with it goes to data if it is there */
+bool tt_probe(TT *tt, int worker, uint64_t key, uint64_t *data) {
+    TTEntry *e = &tt->entries[key & tt->mask];
+    TTStats *stats = &tt->counters[worker].stats;
+    uint64_t check = atomic_load_explicit(&e->check, memory_order_relaxed);
+    uint64_t d = atomic_load_explicit(&e->data, memory_order_relaxed);
+
+    stats->probes++;
+    if (d == 0 || (check ^ d) != key) {
+        return false;
+    }
+    stats->hits++;
+    *data = d;
+    return true;
+}
+
+
+/* sum of the counters of all workers, only exact while none is running */
+void tt_stats(TT *tt, TTStats *stats) {
+    memset(stats, 0, sizeof(TTStats));
+    for (int i = 0; i < tt->nworkers; i++) {
+        stats->probes += tt->counters[i].stats.probes;
+        stats->hits += tt->counters[i].stats.hits;
+        stats->stores += tt->counters[i].stats.stores;
+        stats->evictions += tt->counters[i].stats.evictions;
+    }
+}
+
+
+/* data must have TT_USED set */
+void tt_store(TT *tt, int worker, uint64_t key, uint64_t data) {
+    TTEntry *e = &tt->entries[key & tt->mask];
+    TTStats *stats = &tt->counters[worker].stats;
+    uint64_t check = atomic_load_explicit(&e->check, memory_order_relaxed);
+    uint64_t d = atomic_load_explicit(&e->data, memory_order_relaxed);
+
+    stats->stores++;
+    if (d != 0 && (check ^ d) != key) {
+        stats->evictions++;
+    }
+    atomic_store_explicit(&e->check, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&e->data, data, memory_order_relaxed);
+}
@@ -0,0 +1,52 @@
+#ifndef __tt_h__
+#define __tt_h__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/* the data of an entry is never 0 so that an empty slot cannot match */
+#define TT_USED ((uint64_t) 1 << 63)
+#define TT_CACHE_LINE 64
+
+
+/* the key is stored xor the data: a reader that sees the two words from
+ * different writes gets a mismatch and treats it as a miss, so no lock is
+ * needed */
+typedef struct tt_entry {
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;
+} TTEntry;
+
+typedef struct tt_stats {
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t stores;
+    uint64_t evictions;  /* stores that replaced an entry for another key */
+} TTStats;
+
+/* the statistics of one thread, alone on its cache line so that counting
+ * needs neither atomics nor lines bouncing between threads */
+typedef struct tt_counters {
+    TTStats stats;
+} __attribute__((aligned(TT_CACHE_LINE))) TTCounters;
+
+/* fixed size table shared by all threads, an entry goes to the slot given
+ * by the low bits of its key and replaces whatever was there; every thread
+ * passes its worker id and counts into its own counters */
+typedef struct tt {
+    TTEntry *entries;
+    uint64_t mask;
+    TTCounters *counters;  /* one per worker */
+    int nworkers;
+} TT;
+
+
+void tt_free(TT *);
+TT *tt_new(int, int);
+bool tt_probe(TT *, int, uint64_t, uint64_t *);
+void tt_stats(TT *, TTStats *);
+void tt_store(TT *, int, uint64_t, uint64_t);
+
+#endif
@@ -0,0 +1,195 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "replay.h"
+#include "threadpool.h"
+
+
+enum VERIFY_STATUS {VERIFY_OK, VERIFY_MISMATCH, VERIFY_INVALID};
+
+
+typedef struct verdict {
+    char *name;  /* file name in the directory */
+    int status;  /* one of VERIFY_STATUS */
+    ReplayResult recorded;
+    ReplayResult replayed;
+} Verdict;
+
+typedef struct archive {
+    int dirfd;
+    Verdict *verdicts;
+    int nverdicts;
+} Archive;
+
+
+bool list_replays(Archive *, const char *);
+void usage(char *);
+void verify_replay(void *, int64_t, int);
+
+
+/* every regular file of the directory is taken for a replay */
+bool list_replays(Archive *a, const char *path) {
+    DIR *dir = NULL;
+    struct dirent *entry;
+    int capacity = 0;
+
+    a->dirfd = open(path, O_RDONLY | O_DIRECTORY);
+    check(a->dirfd >= 0, "Failed to open %s", path);
+    dir = fdopendir(dup(a->dirfd));
+    check(dir != NULL, "Failed to read %s", path);
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN) {
+            continue;
+        }
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        if (a->nverdicts == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 1024;
+            Verdict *verdicts = realloc(a->verdicts, capacity * sizeof(Verdict));
+            check_mem(verdicts);
+            a->verdicts = verdicts;
+        }
+        Verdict *c = &a->verdicts[a->nverdicts];
+        memset(c, 0, sizeof(Verdict));
+        c->name = strdup(entry->d_name);
+        check_mem(c->name);
+        a->nverdicts++;
+    }
+    closedir(dir);
+    return true;
+
+    error:
+        if (dir != NULL) {
+            closedir(dir);
+        }
+        return false;
+}
+
+
+void usage(char *name) {
+    fprintf(stderr, "usage: %s [-j threads] DIRECTORY\n", name);
+}
+
+
+/* the replay is played straight from the page cache, nothing is copied */
+void verify_replay(void *arg, int64_t index, int worker) {
+    Archive *a = arg;
+    Verdict *c = &a->verdicts[index];
+    struct stat st;
+    void *data = MAP_FAILED;
+
+    c->status = VERIFY_INVALID;
+    int fd = openat(a->dirfd, c->name, O_RDONLY);
+    check(fd >= 0, "Failed to open %s", c->name);
+    check(fstat(fd, &st) == 0 && st.st_size > 0, "Failed to get the size of %s", c->name);
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    check(data != MAP_FAILED, "Failed to map %s", c->name);
+    /* advice values are not flags, each one takes its own call */
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    madvise(data, st.st_size, MADV_WILLNEED);
+    check(replay_play(data, st.st_size, &c->recorded, &c->replayed), "Failed to replay %s", c->name);
+    c->status = replay_matches(&c->recorded, &c->replayed) ? VERIFY_OK : VERIFY_MISMATCH;
+
+    error:
+        if (data != MAP_FAILED) {
+            munmap(data, st.st_size);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+}
+
+
+int main(int argc, char *argv[]) {
+    Archive archive = {-1, NULL, 0};
+    Pool *pool = NULL;
+    int nthreads = 0;
+    struct timespec start, end;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:h")) != -1) {
+        switch (opt) {
+            case 'j':
+                nthreads = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    check(list_replays(&archive, argv[optind]), "Failed to list replays");
+    pool = pool_new(nthreads);
+    check(pool != NULL, "Failed to start thread pool");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pool_run(pool, archive.nverdicts, verify_replay, &archive);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    int mismatches = 0, invalid = 0;
+    uint64_t events = 0;
+    for (int i = 0; i < archive.nverdicts; i++) {
+        Verdict *c = &archive.verdicts[i];
+        events += c->replayed.events;
+        if (c->status == VERIFY_INVALID) {
+            printf("%s: invalid\n", c->name);
+            invalid++;
+        }
+        else if (c->status == VERIFY_MISMATCH) {
+            printf(
+                "%s: recorded score %u, rows %u, level %u, %u pieces, replayed score %u, "
+                "rows %u, level %u, %u pieces\n",
+                c->name,
+                c->recorded.score,
+                c->recorded.lines,
+                c->recorded.level,
+                c->recorded.pieces,
+                c->replayed.score,
+                c->replayed.lines,
+                c->replayed.level,
+                c->replayed.pieces
+            );
+            mismatches++;
+        }
+    }
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(
+        stderr,
+        "%d games on %d threads in %.3f s: %d mismatches, %d invalid, %.1f games/s, %.0f events/s\n",
+        archive.nverdicts,
+        pool_size(pool),
+        seconds,
+        mismatches,
+        invalid,
+        archive.nverdicts / seconds,
+        events / seconds
+    );
+
+    pool_free(pool);
+    for (int i = 0; i < archive.nverdicts; i++) {
+        free(archive.verdicts[i].name);
+    }
+    free(archive.verdicts);
+    close(archive.dirfd);
+    return mismatches + invalid > 0 ? 1 : 0;
+
+    error:
+        pool_free(pool);
+        free(archive.verdicts);
+        return 2;
+}
@@ -1,8 +1,14 @@
 import json
+import time
 import tkinter as tk
 
 from random import randint
 
+try:
+    import tetris_engine
+except ImportError:
+    tetris_engine = None
+
 SCORES_FILE = "scores.json"
 DELAYS = {
     1: 500,
@@ -25,6 +31,7 @@ CANVAS_HEIGHT = BOARD_HEIGHT * CELL_HEIGHT + 1
 CANVAS_BG = "gray75"
 CELL_OUTLINE = "gray50"
 PIECE_OUTLINE = "black"
+FRAME_DELAY = 16
 
 PIECE_COLORS = [
     "deep sky blue",
@@ -590,6 +597,87 @@ class Board(tk.Canvas):
         self.master.destroy()
 
 
+class EngineBoard(Board):
+    """The same game played by the C engine (make python in c_version)"""
+
+    KEYS = {
+        "Left": "ACTION_LEFT",
+        "Right": "ACTION_RIGHT",
+        "Down": "ACTION_DOWN",
+        "a": "ACTION_ROTATE_ANTICLOCK",
+        "d": "ACTION_ROTATE_CLOCK",
+    }
+
+    def __init__(self, parent):
+        super().__init__(
+            parent,
+            width=tetris_engine.WIDTH * CELL_WIDTH + 1,
+            height=tetris_engine.HEIGHT * CELL_HEIGHT + 1,
+        )
+        self.game = tetris_engine.Game()
+        self.started = None
+        self.held = set()
+        self.drawn = bytes(self.nrows * self.ncols)
+        self.cells = [
+            self.create_rectangle(
+                j * self.cell_width + 1,
+                i * self.cell_height + 1,
+                (j + 1) * self.cell_width + 1,
+                (i + 1) * self.cell_height + 1,
+                fill=VALUE_TO_COLOR[0],
+                outline=self.cell_outline,
+            )
+            for i in range(self.nrows)
+            for j in range(self.ncols)
+        ]
+
+    def draw_board(self, from_row=None, to_row=None):
+        playfield = self.game.playfield()
+        for k, (old, new) in enumerate(zip(self.drawn, playfield)):
+            if old != new:
+                self.itemconfigure(
+                    self.cells[k],
+                    fill=VALUE_TO_COLOR[new],
+                    outline=PIECE_OUTLINE if new else self.cell_outline,
+                )
+        self.drawn = playfield
+
+    def spawn_piece(self):
+        self.bind("<KeyPress>", self.press)
+        self.bind("<KeyRelease>", self.release)
+
+    def press(self, event):
+        action = self.KEYS.get(event.keysym)
+        if action is not None and action not in self.held:
+            self.held.add(action)
+            self.game.press(getattr(tetris_engine, action))
+
+    def release(self, event):
+        action = self.KEYS.get(event.keysym)
+        if action in self.held:
+            self.held.discard(action)
+            self.game.release(getattr(tetris_engine, action))
+
+    def start(self):
+        # the engine runs on its own fixed steps, each frame runs the ones
+        # due since the start
+        if self.started is None:
+            self.started = time.monotonic()
+        due = int((time.monotonic() - self.started) * tetris_engine.LOGIC_HZ)
+        self.game.step(due - self.game.steps)
+        self.draw_board()
+        if self.score != self.game.score:
+            self.score = self.game.score
+            self.score_widget.configure(text=str(self.score))
+        if self.level != self.game.level:
+            self.level = self.game.level
+            self.level_widget.configure(text=str(self.level))
+        if self.game.over:
+            self.game_over()
+        else:
+            self.after(FRAME_DELAY, self.start)
+
+
 def main():
     root = tk.Tk()
     info = tk.Frame(root, name="info")
@@ -602,7 +690,7 @@ def main():
     level_txt.pack()
     level = tk.Label(info, name="level", text="1")
     level.pack()
-    board = Board(root)
+    board = Board(root) if tetris_engine is None else EngineBoard(root)
     board.pack(side=tk.TOP, padx=5, pady=5)
     board.draw_board()
     board.spawn_piece()